@@ -0,0 +1,405 @@
+// Measures GO-to-output latency through the cue engine: from CueEngine::go()
+// to the first buffer reaching the cue's sink. Cues come from a generated
+// show and play the way stageshow-headless plays them: playbin into the
+// shared audio mixer (with a fakesink for the device) and, for video, a
+// synced fakesink for the program output. So the fader, the interaudiosink
+// and audiomixer, BusDispatcher and the engine's standby and gapless paths
+// are all part of what is timed.
+//
+//   golatency_bench [iterations] [max_p95_ms]
+//
+// Synthetic media is rendered with videotestsrc/audiotestsrc into a
+// temporary directory first; formats whose encoders are missing are skipped.
+// Each configuration is started cold (pipeline built on GO, as for a cue
+// that was not selected) and from standby (set_standby() first, as for the
+// selected cue). The "chained" row is the gap between the last buffer of
+// one cue and the first of the next when an auto_next cue hands off
+// gaplessly: when the next buffer renders, on the pipeline clock, after the
+// previous one ends. The first cue is sought to its last second. Defaults:
+// 20 iterations, no limit. With max_p95_ms, exits non-zero if any p95 is
+// above it.
+
+#include <glibmm/init.h>
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cueengine.h"
+#include "cuescheduler.h"
+#include "showfile.h"
+
+namespace {
+
+enum class CueKind { Audio, Video };
+enum class Start { Cold, Standby, Chained };
+
+struct MediaConfig {
+    CueKind kind;
+    const char* name;
+    const char* extension;
+    const char* encode; // gst-launch description, filesink appended
+};
+
+// Five seconds each; long enough that EOS never races the measurement
+const MediaConfig configs[] = {
+    {CueKind::Video, "h264-720p", "mp4",
+     "videotestsrc num-buffers=150 ! video/x-raw,width=1280,height=720,framerate=30/1 ! "
+     "x264enc tune=zerolatency key-int-max=30 ! h264parse ! mp4mux"},
+    {CueKind::Video, "h264-1080p", "mp4",
+     "videotestsrc num-buffers=150 ! video/x-raw,width=1920,height=1080,framerate=30/1 ! "
+     "x264enc tune=zerolatency key-int-max=30 ! h264parse ! mp4mux"},
+    {CueKind::Video, "h265-1080p", "mp4",
+     "videotestsrc num-buffers=150 ! video/x-raw,width=1920,height=1080,framerate=30/1 ! "
+     "x265enc tune=zerolatency key-int-max=30 ! h265parse ! mp4mux"},
+    {CueKind::Video, "vp8-720p", "webm",
+     "videotestsrc num-buffers=150 ! video/x-raw,width=1280,height=720,framerate=30/1 ! "
+     "vp8enc deadline=1 keyframe-max-dist=30 ! webmmux"},
+    {CueKind::Video, "mjpeg-1080p", "avi",
+     "videotestsrc num-buffers=150 ! video/x-raw,width=1920,height=1080,framerate=30/1 ! "
+     "jpegenc ! avimux"},
+    {CueKind::Audio, "wav-48k", "wav",
+     "audiotestsrc num-buffers=250 samplesperbuffer=960 ! audio/x-raw,rate=48000,channels=2 ! wavenc"},
+    {CueKind::Audio, "flac-48k", "flac",
+     "audiotestsrc num-buffers=250 samplesperbuffer=960 ! audio/x-raw,rate=48000,channels=2 ! "
+     "audioconvert ! flacenc"},
+    {CueKind::Audio, "vorbis-48k", "ogg",
+     "audiotestsrc num-buffers=250 samplesperbuffer=960 ! audio/x-raw,rate=48000,channels=2 ! "
+     "audioconvert ! vorbisenc ! oggmux"},
+    {CueKind::Audio, "opus-48k", "opus",
+     "audiotestsrc num-buffers=250 samplesperbuffer=960 ! audio/x-raw,rate=48000,channels=2 ! "
+     "audioconvert ! opusenc ! oggmux"},
+};
+
+const GstClockTime wait_timeout = 5 * GST_SECOND;
+
+// Runs the default main loop, which the engine and its dispatcher need,
+// until `done` or the timeout
+bool run_until(const std::function<bool()>& done, GstClockTime timeout = wait_timeout)
+{
+    gint64 deadline = g_get_monotonic_time() + static_cast<gint64>(timeout / GST_USECOND);
+    while (!done()) {
+        if (g_get_monotonic_time() >= deadline)
+            return false;
+        if (!g_main_context_iteration(nullptr, FALSE))
+            g_usleep(100);
+    }
+    return true;
+}
+
+// The engine logs every GO to stdout; keeps that out of the table
+class QuietStdout
+{
+public:
+    QuietStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(saved); }
+
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+// Gapless hand-off seen at the cue's sink, from its streaming thread
+struct Chained {
+    std::mutex mutex;
+    GstElement* pipeline = nullptr;
+    GstSegment segment;
+    int stream_starts = 0;
+    GstClockTime last_end = GST_CLOCK_TIME_NONE; // clock time the first cue's last buffer ends
+    gint64 gap_us = 0;
+    bool measured = false;
+};
+
+GstPadProbeReturn on_chained_probe(GstPad* /*pad*/, GstPadProbeInfo* info, gpointer user_data)
+{
+    auto* chained = static_cast<Chained*>(user_data);
+    std::lock_guard<std::mutex> lock(chained->mutex);
+    if (chained->measured)
+        return GST_PAD_PROBE_OK;
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_STREAM_START)
+            chained->stream_starts++;
+        else if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT)
+            gst_event_copy_segment(event, &chained->segment);
+        return GST_PAD_PROBE_OK;
+    }
+
+    // A synced sink renders a buffer at its running time, or on arrival if late
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClock* clock = gst_element_get_clock(chained->pipeline);
+    if (!clock || !GST_BUFFER_PTS_IS_VALID(buffer)) {
+        if (clock)
+            gst_object_unref(clock);
+        return GST_PAD_PROBE_OK;
+    }
+    GstClockTime now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+    GstClockTime running = gst_segment_to_running_time(&chained->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    GstClockTime render = std::max(now, gst_element_get_base_time(chained->pipeline) + running);
+
+    if (chained->stream_starts >= 2 && GST_CLOCK_TIME_IS_VALID(chained->last_end)) {
+        chained->gap_us = GST_CLOCK_DIFF(chained->last_end, render) / 1000;
+        chained->measured = true;
+        return GST_PAD_PROBE_OK;
+    }
+    chained->last_end = render + (GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) : 0);
+    return GST_PAD_PROBE_OK;
+}
+
+bool wait_for_bus(GstElement* pipeline, GstMessageType type, std::string& error)
+{
+    GstBus* bus = gst_element_get_bus(pipeline);
+    GstMessage* message = gst_bus_timed_pop_filtered(bus, 60 * GST_SECOND,
+                                                     static_cast<GstMessageType>(type | GST_MESSAGE_ERROR));
+    gst_object_unref(bus);
+    if (!message) {
+        error = "timed out";
+        return false;
+    }
+    bool ok = GST_MESSAGE_TYPE(message) == type;
+    if (!ok) {
+        GError* err = nullptr;
+        gst_message_parse_error(message, &err, nullptr);
+        error = err ? err->message : "error";
+        g_clear_error(&err);
+    }
+    gst_message_unref(message);
+    return ok;
+}
+
+bool render_media(const MediaConfig& config, const std::string& path, std::string& error)
+{
+    std::string description = std::string(config.encode) + " ! filesink location=\"" + path + "\"";
+    GError* err = nullptr;
+    GstElement* pipeline = gst_parse_launch(description.c_str(), &err);
+    if (!pipeline || err) {
+        error = err ? err->message : "cannot build encoder";
+        g_clear_error(&err);
+        if (pipeline)
+            gst_object_unref(pipeline);
+        return false;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    bool ok = wait_for_bus(pipeline, GST_MESSAGE_EOS, error);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok;
+}
+
+bool pre_rolled(const std::shared_ptr<CueItem>& cue)
+{
+    GstState state = GST_STATE_NULL;
+    return cue->gst_pipeline
+        && gst_element_get_state(cue->gst_pipeline, &state, nullptr, 0) == GST_STATE_CHANGE_SUCCESS
+        && state == GST_STATE_PAUSED;
+}
+
+// One GO; returns the latency in ms, or NaN on failure
+double measure(CueEngine& engine, const std::shared_ptr<CueItem>& cue, bool standby)
+{
+    // Standby pre-rolls first, like the selected row; a cold GO builds the pipeline
+    if (standby) {
+        engine.set_standby(cue);
+        if (!run_until([&cue]() { return pre_rolled(cue); })) {
+            engine.stop(cue);
+            return std::nan("");
+        }
+    }
+
+    gint64 go_us = g_get_monotonic_time();
+    engine.go(cue);
+    bool rendered = run_until([&cue]() { return cue->health.first_buffer_us.load() != 0; });
+    double latency_ms = rendered ? (cue->health.first_buffer_us.load() - go_us) / 1000.0 : std::nan("");
+
+    engine.stop(cue);
+    return latency_ms;
+}
+
+// One gapless hand-off from `head` to the cue after it; returns the gap in
+// ms, or NaN on failure
+double measure_chained(CueEngine& engine, const std::shared_ptr<CueItem>& head, CueKind kind)
+{
+    engine.go(head);
+    double gap_ms = std::nan("");
+    Chained chained;
+    gst_segment_init(&chained.segment, GST_FORMAT_TIME);
+    GstPad* pad = nullptr;
+    gulong probe = 0;
+
+    // Only the end of the first cue matters
+    gint64 duration = 0;
+    bool ready = run_until([&head]() { return head->health.first_buffer_us.load() != 0; })
+              && gst_element_query_duration(head->gst_pipeline, GST_FORMAT_TIME, &duration)
+              && duration > GST_SECOND;
+    if (ready) {
+        chained.pipeline = head->gst_pipeline;
+        GstElement* sink = nullptr;
+        g_object_get(head->gst_pipeline, kind == CueKind::Audio ? "audio-sink" : "video-sink", &sink, nullptr);
+        if (sink) {
+            pad = gst_element_get_static_pad(sink, "sink");
+            gst_object_unref(sink);
+        }
+        ready = pad != nullptr;
+    }
+    if (ready) {
+        // The seek's segment and the rest of the first file arrive after this
+        probe = gst_pad_add_probe(pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                                  on_chained_probe, &chained, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(chained.mutex);
+            chained.stream_starts = 1;
+        }
+        ready = gst_element_seek_simple(head->gst_pipeline, GST_FORMAT_TIME,
+                                        static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE),
+                                        duration - GST_SECOND);
+    }
+    if (ready) {
+        bool measured = run_until([&chained]() {
+            std::lock_guard<std::mutex> lock(chained.mutex);
+            return chained.measured;
+        });
+        if (measured)
+            gap_ms = chained.gap_us / 1000.0;
+    }
+
+    if (pad) {
+        if (probe)
+            gst_pad_remove_probe(pad, probe);
+        gst_object_unref(pad);
+    }
+    engine.stop_all();
+    return gap_ms;
+}
+
+// A show with one cue for GO and an auto_next pair for the hand-off
+bool generate_show(const std::string& show_path, CueKind kind, const std::string& media_path,
+                   std::vector<std::shared_ptr<CueItem>>& cues, std::string& error)
+{
+    auto type = kind == CueKind::Audio ? CueItem::Type::Audio : CueItem::Type::Video;
+    CueList list;
+    list.push_back(std::make_shared<CueItem>(type, "go", media_path, 0, 0, 0, false, false, false, false));
+    list.push_back(std::make_shared<CueItem>(type, "chain", media_path, 0, 0, 0, true, false, false, false));
+    list.push_back(std::make_shared<CueItem>(type, "chained", media_path, 0, 0, 0, false, false, false, false));
+    return save_show(show_path, list, error) && load_show(show_path, cues, error) && cues.size() == 3;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    // Nearest rank
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Glib::init();
+    gst_init(&argc, &argv);
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    double max_p95_ms = argc > 2 ? std::atof(argv[2]) : 0.0;
+    if (iterations < 1)
+        iterations = 1;
+
+    GError* err = nullptr;
+    gchar* dir = g_dir_make_tmp("stageshow-golatency-XXXXXX", &err);
+    if (!dir) {
+        std::cerr << "Cannot create a temporary directory: " << err->message << std::endl;
+        g_clear_error(&err);
+        return 1;
+    }
+
+    // As stageshow-headless sets it up
+    auto scheduler = std::make_shared<CueScheduler>();
+    CueEngine engine(scheduler, "fakesink");
+
+    std::cout << iterations << " GOs per configuration through the cue engine, fakesink outputs"
+              << (max_p95_ms > 0 ? ", p95 limit " + std::to_string(max_p95_ms) + " ms" : std::string())
+              << std::endl;
+    std::cout << std::left << std::setw(7) << "cue" << std::setw(13) << "media" << std::setw(9) << "start"
+              << std::right << std::setw(9) << "p50" << std::setw(9) << "p95" << std::setw(9) << "p99"
+              << std::setw(9) << "max" << "  (ms)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    bool all_ok = true;
+    for (const auto& config : configs) {
+        const char* kind = config.kind == CueKind::Audio ? "audio" : "video";
+        std::string file = std::string(config.name) + "." + config.extension;
+        gchar* path = g_build_filename(dir, file.c_str(), nullptr);
+        std::string show = std::string(path) + ".show";
+        std::vector<std::shared_ptr<CueItem>> cues;
+        std::string error;
+        if (!render_media(config, path, error) || !generate_show(show, config.kind, path, cues, error)) {
+            std::cout << std::left << std::setw(7) << kind << std::setw(13) << config.name
+                      << "skipped: " << error << std::endl;
+            g_remove(show.c_str());
+            g_remove(path);
+            g_free(path);
+            continue;
+        }
+
+        engine.clear();
+        for (const auto& cue : cues)
+            engine.cues().push_back(cue);
+
+        for (Start start : {Start::Cold, Start::Standby, Start::Chained}) {
+            // A gap may be negative (the next buffer rendered early), a latency may not
+            auto run = [&]() {
+                QuietStdout quiet;
+                if (start == Start::Chained)
+                    return measure_chained(engine, cues[1], config.kind);
+                return measure(engine, cues[0], start == Start::Standby);
+            };
+
+            // Warm up the plugin registry and decoder caches
+            run();
+
+            std::vector<double> samples;
+            int failures = 0;
+            for (int i = 0; i < iterations; ++i) {
+                double ms = run();
+                if (std::isnan(ms))
+                    failures++;
+                else
+                    samples.push_back(ms);
+            }
+
+            const char* label = start == Start::Cold ? "cold" : start == Start::Standby ? "standby" : "chained";
+            std::cout << std::left << std::setw(7) << kind << std::setw(13) << config.name << std::setw(9) << label
+                      << std::right;
+            if (samples.empty()) {
+                std::cout << "  no output within " << wait_timeout / GST_SECOND << " s" << std::endl;
+                all_ok = false;
+                continue;
+            }
+            std::sort(samples.begin(), samples.end());
+            double p95 = percentile(samples, 95);
+            bool ok = max_p95_ms <= 0 || p95 <= max_p95_ms;
+            all_ok = all_ok && ok && failures == 0;
+            std::cout << std::setw(9) << percentile(samples, 50) << std::setw(9) << p95
+                      << std::setw(9) << percentile(samples, 99) << std::setw(9) << samples.back();
+            if (failures > 0)
+                std::cout << "  " << failures << " failed";
+            std::cout << (ok ? "" : "  OVER LIMIT") << std::endl;
+        }
+        engine.clear();
+        g_remove(show.c_str());
+        g_remove(path);
+        g_free(path);
+    }
+
+    g_rmdir(dir);
+    g_free(dir);
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// Measures slide transition rendering at 1080p against the frame budget.
+//
+//   transition_bench [threads] [frames] [fps]
+//
+// Defaults: 4 threads, 300 frames, 60 fps budget. Exits non-zero if any
+// transition misses the budget on average.
+
+#include "transition.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const int width = 1920;
+const int height = 1080;
+
+RgbaFrame make_frame(std::vector<uint8_t>& storage, uint8_t seed)
+{
+    storage.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < storage.size(); ++i)
+        storage[i] = (i & 3) == 3 ? 0xff : static_cast<uint8_t>(i * 31 + seed);
+    RgbaFrame frame;
+    frame.data = storage.data();
+    frame.width = width;
+    frame.height = height;
+    frame.stride = width * 4;
+    return frame;
+}
+
+bool check_kernels()
+{
+    // Odd length exercises the vector blocks and the scalar tail together
+    std::vector<uint8_t> a(1027), b(1027), out(1027);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<uint8_t>(i * 7);
+        b[i] = static_cast<uint8_t>(255 - i * 13);
+    }
+    for (unsigned alpha = 0; alpha <= 256; alpha += 37) {
+        blend_rgba(out.data(), a.data(), b.data(), a.size(), alpha);
+        for (size_t i = 0; i < a.size(); ++i) {
+            unsigned expect = (a[i] * (256 - alpha) + b[i] * alpha + 128) >> 8;
+            if (out[i] != expect) {
+                std::cerr << "blend_rgba mismatch at " << i << " alpha " << alpha << std::endl;
+                return false;
+            }
+        }
+        fade_rgba(out.data(), a.data(), a.size(), alpha);
+        for (size_t i = 0; i < a.size(); ++i) {
+            unsigned expect = (i & 3) == 3 ? 0xff : (a[i] * alpha + 128) >> 8;
+            if (out[i] != expect) {
+                std::cerr << "fade_rgba mismatch at " << i << " alpha " << alpha << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 300;
+    double fps = argc > 3 ? std::atof(argv[3]) : 60.0;
+    double budget_ms = 1000.0 / fps;
+
+    if (!check_kernels())
+        return 1;
+
+    std::vector<uint8_t> from_storage, to_storage, out_storage;
+    RgbaFrame from = make_frame(from_storage, 1);
+    RgbaFrame to = make_frame(to_storage, 2);
+    RgbaFrame out = make_frame(out_storage, 3);
+
+    TransitionRenderer renderer(threads);
+    std::cout << "1920x1080 RGBA, " << renderer.get_threads() << " threads, "
+              << frames << " frames, budget " << std::fixed << std::setprecision(2)
+              << budget_ms << " ms" << std::endl;
+
+    bool all_ok = true;
+    for (auto type : {TransitionType::Crossfade, TransitionType::DipToBlack, TransitionType::Wipe}) {
+        // Warm up caches and page in the buffers
+        renderer.render(type, 0.5, from, to, out);
+
+        double worst_ms = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            auto frame_start = std::chrono::steady_clock::now();
+            renderer.render(type, static_cast<double>(i) / frames, from, to, out);
+            std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - frame_start;
+            worst_ms = std::max(worst_ms, frame_time.count());
+        }
+        std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+
+        double mean_ms = total.count() / frames;
+        bool ok = mean_ms <= budget_ms;
+        all_ok = all_ok && ok;
+        std::cout << std::left << std::setw(14) << transition_type_name(type)
+                  << " mean " << std::setw(7) << mean_ms << " ms"
+                  << "  worst " << std::setw(7) << worst_ms << " ms"
+                  << "  " << std::setw(8) << 1000.0 / mean_ms << " fps"
+                  << (ok ? "  ok" : "  OVER BUDGET") << std::endl;
+    }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include "audioengine.h"
+#include <algorithm>
+#include <iostream>
+
+AudioEngine::AudioEngine(int input_count, int rate, int channels, const std::string& sink_factory, int max_input_count)
+: max_inputs(static_cast<size_t>(std::max(input_count, max_input_count)))
+{
+    mix_caps = gst_caps_new_simple("audio/x-raw",
+                                   "format", G_TYPE_STRING, "F32LE",
+                                   "layout", G_TYPE_STRING, "interleaved",
+                                   "rate", G_TYPE_INT, rate,
+                                   "channels", G_TYPE_INT, channels,
+                                   nullptr);
+
+    pipeline = gst_pipeline_new("audio-engine");
+    mixer = gst_element_factory_make("audiomixer", nullptr);
+    GstElement* capsfilter = gst_element_factory_make("capsfilter", nullptr);
+    GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
+    GstElement* sink = gst_element_factory_make(sink_factory.c_str(), nullptr);
+    if (!mixer || !capsfilter || !convert || !sink) {
+        std::cerr << "Audio engine: missing audiomixer/" << sink_factory << " elements" << std::endl;
+        return;
+    }
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(sink), "sync"))
+        g_object_set(sink, "sync", TRUE, nullptr);
+
+    g_object_set(capsfilter, "caps", mix_caps, nullptr);
+    gst_bin_add_many(GST_BIN(pipeline), mixer, capsfilter, convert, sink, nullptr);
+    gst_element_link_many(mixer, capsfilter, convert, sink, nullptr);
+
+    for (int i = 0; i < input_count; ++i)
+        add_input();
+
+    // Running from the start keeps the device open and the clock ticking
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+}
+
+bool AudioEngine::add_input()
+{
+    GstElement* src = gst_element_factory_make("interaudiosrc", nullptr);
+    if (!src)
+        return false;
+
+    gchar* channel = channel_name(static_cast<int>(inputs.size()));
+    // Short periods keep the hand-off from cue to mixer within ~30 ms
+    g_object_set(src,
+                 "channel", channel,
+                 "period-time", static_cast<guint64>(10 * GST_MSECOND),
+                 "latency-time", static_cast<guint64>(30 * GST_MSECOND),
+                 nullptr);
+    g_free(channel);
+
+    gst_bin_add(GST_BIN(pipeline), src);
+    if (!gst_element_link(src, mixer)) {
+        gst_bin_remove(GST_BIN(pipeline), src);
+        return false;
+    }
+
+    Input input;
+    GstPad* src_pad = gst_element_get_static_pad(src, "src");
+    input.pad = gst_pad_get_peer(src_pad);
+    gst_object_unref(src_pad);
+    inputs.push_back(input);
+
+    // Added to a running mix, it joins from here
+    gst_element_sync_state_with_parent(src);
+    return true;
+}
+
+AudioEngine::~AudioEngine()
+{
+    if (pipeline) {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        for (auto& input : inputs) {
+            if (input.pad)
+                gst_object_unref(input.pad);
+        }
+        gst_object_unref(pipeline);
+    }
+    if (mix_caps)
+        gst_caps_unref(mix_caps);
+}
+
+gchar* AudioEngine::channel_name(int input)
+{
+    return g_strdup_printf("stageshow-audio-%d", input);
+}
+
+GstElement* AudioEngine::create_cue_sink(int& input)
+{
+    input = -1;
+    if (inputs.empty() || !inputs[0].pad)
+        return nullptr;
+
+    // The free input taken longest ago
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!inputs[i].busy && (input < 0 || inputs[i].last_used < inputs[input].last_used))
+            input = static_cast<int>(i);
+    }
+    if (input < 0) {
+        if (inputs.size() >= max_inputs || !add_input()) {
+            std::cerr << "Audio engine: all " << inputs.size() << " inputs busy" << std::endl;
+            return nullptr;
+        }
+        input = static_cast<int>(inputs.size()) - 1;
+    }
+    inputs[input].busy = true;
+    inputs[input].last_used = ++use_counter;
+    set_volume(input, 1.0);
+
+    GError* err = nullptr;
+    GstElement* bin = gst_parse_bin_from_description(
+        "audioconvert ! audioresample ! volume name=fader ! capsfilter name=mixcaps ! interaudiosink name=mixsink",
+        TRUE, &err);
+    if (!bin) {
+        std::cerr << "Audio engine: cannot build cue sink: " << (err ? err->message : "unknown") << std::endl;
+        g_clear_error(&err);
+        inputs[input].busy = false;
+        input = -1;
+        return nullptr;
+    }
+
+    GstElement* mixcaps = gst_bin_get_by_name(GST_BIN(bin), "mixcaps");
+    g_object_set(mixcaps, "caps", mix_caps, nullptr);
+    gst_object_unref(mixcaps);
+
+    GstElement* mixsink = gst_bin_get_by_name(GST_BIN(bin), "mixsink");
+    gchar* channel = channel_name(input);
+    g_object_set(mixsink, "channel", channel, nullptr);
+    g_free(channel);
+    gst_object_unref(mixsink);
+
+    return bin;
+}
+
+void AudioEngine::release_input(int input)
+{
+    if (input < 0 || input >= static_cast<int>(inputs.size()))
+        return;
+
+    inputs[input].busy = false;
+}
+
+void AudioEngine::use_clock(GstElement* pipeline_to_slave)
+{
+    if (!pipeline)
+        return;
+
+    // Valid before the engine has finished going to PLAYING
+    GstClock* clock = gst_pipeline_get_pipeline_clock(GST_PIPELINE(pipeline));
+    if (clock) {
+        gst_pipeline_use_clock(GST_PIPELINE(pipeline_to_slave), clock);
+        gst_object_unref(clock);
+    }
+}
+
+void AudioEngine::set_volume(int input, double volume)
+{
+    if (input < 0 || input >= static_cast<int>(inputs.size()) || !inputs[input].pad)
+        return;
+
+    g_object_set(inputs[input].pad, "volume", volume, nullptr);
+}
+
+double AudioEngine::get_volume(int input) const
+{
+    gdouble volume = 1.0;
+    if (input >= 0 && input < static_cast<int>(inputs.size()) && inputs[input].pad)
+        g_object_get(inputs[input].pad, "volume", &volume, nullptr);
+    return volume;
+}
+
+GstPad* AudioEngine::get_mixer_pad(int input) const
+{
+    if (input < 0 || input >= static_cast<int>(inputs.size()))
+        return nullptr;
+    return inputs[input].pad;
+}
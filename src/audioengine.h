@@ -0,0 +1,62 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <string>
+#include <vector>
+
+// One audio mixing engine for every cue: a fixed set of interaudiosrc
+// inputs mixed by a single audiomixer into one audio sink, so concurrent
+// cues share one device connection, one latency and one clock.
+//
+// A cue pipeline gets a sink bin (convert/resample to the mix format, then
+// interaudiosink on a free input's channel) to use as its playbin
+// audio-sink, and is slaved to the engine clock with use_clock(). Each input
+// has its own gain on the mixer pad; the bin also carries a "fader" volume
+// element for per-cue fades (see fade.h).
+//
+// `sink` is the element factory for the device; headless runs pass
+// "fakesink", which is then synced so the mix still runs in real time.
+//
+// Standby pipelines and loop crossfade partners hold inputs too, so when all
+// are busy another is added to the running mix, up to `max_inputs`. Past
+// that create_cue_sink() fails and the cue has to use a sink of its own;
+// an input is never shared, as two cues on one channel garble each other.
+class AudioEngine
+{
+public:
+    AudioEngine(int inputs = 8, int rate = 48000, int channels = 2,
+                const std::string& sink = "autoaudiosink", int max_inputs = 32);
+    ~AudioEngine();
+
+    AudioEngine(const AudioEngine&) = delete;
+    AudioEngine& operator=(const AudioEngine&) = delete;
+
+    // Audio sink bin for a cue pipeline, bound to a free input (stored in
+    // `input`); nullptr when every input up to max_inputs is busy
+    GstElement* create_cue_sink(int& input);
+    void release_input(int input);
+
+    // Slave a cue pipeline to the engine clock
+    void use_clock(GstElement* pipeline);
+
+    void set_volume(int input, double volume);
+    double get_volume(int input) const;
+    GstPad* get_mixer_pad(int input) const;
+
+private:
+    struct Input {
+        GstPad* pad = nullptr; // audiomixer sink pad
+        bool busy = false;
+        guint64 last_used = 0;
+    };
+
+    static gchar* channel_name(int input);
+    bool add_input();
+
+    GstElement* pipeline = nullptr;
+    GstElement* mixer = nullptr;
+    GstCaps* mix_caps = nullptr;
+    std::vector<Input> inputs;
+    guint64 use_counter = 0;
+    size_t max_inputs;
+};
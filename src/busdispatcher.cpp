@@ -0,0 +1,244 @@
+#include "busdispatcher.h"
+#include <algorithm>
+
+BusDispatcher::BusDispatcher(unsigned max_rate_hz)
+: min_interval_us(1000000 / std::max(1u, max_rate_hz))
+{
+    dispatcher.connect(sigc::mem_fun(*this, &BusDispatcher::on_dispatch));
+}
+
+BusDispatcher::~BusDispatcher()
+{
+    flush_timer.disconnect();
+    for (auto& entry : watches) {
+        gst_bus_set_sync_handler(entry.second.bus, nullptr, nullptr, nullptr);
+        gst_object_unref(entry.second.bus);
+    }
+}
+
+void BusDispatcher::watch(GstElement* pipeline, Handler handler)
+{
+    if (!pipeline)
+        return;
+    unwatch(pipeline);
+
+    Watch watch;
+    watch.bus = gst_element_get_bus(pipeline);
+    watch.handler = std::move(handler);
+    watch.id = next_id++;
+
+    // The context is freed by the bus when the handler is replaced or unset
+    gst_bus_set_sync_handler(watch.bus, &BusDispatcher::on_sync_message,
+                             new SyncContext{this, watch.id},
+                             [](gpointer data) { delete static_cast<SyncContext*>(data); });
+    watches[pipeline] = std::move(watch);
+}
+
+void BusDispatcher::set_handler(GstElement* pipeline, Handler handler)
+{
+    auto it = watches.find(pipeline);
+    if (it == watches.end()) {
+        watch(pipeline, std::move(handler));
+        return;
+    }
+    it->second.handler = std::move(handler);
+}
+
+void BusDispatcher::unwatch(GstElement* pipeline)
+{
+    auto it = watches.find(pipeline);
+    if (it == watches.end())
+        return;
+
+    gst_bus_set_sync_handler(it->second.bus, nullptr, nullptr, nullptr);
+    gst_object_unref(it->second.bus);
+    guint64 id = it->second.id;
+    watches.erase(it);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                 [id](const Pending& p) { return p.id == id; }),
+                  pending.end());
+    qos.erase(id);
+    buffering.erase(id);
+}
+
+GstBusSyncReply BusDispatcher::on_sync_message(GstBus* /*bus*/, GstMessage* msg, gpointer user_data)
+{
+    auto* context = static_cast<SyncContext*>(user_data);
+    Event event;
+    event.posted_us = g_get_monotonic_time();
+
+    switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_EOS:
+        event.type = Event::Type::Eos;
+        break;
+    case GST_MESSAGE_ERROR: {
+        GError* err = nullptr;
+        gchar* debug = nullptr;
+        gst_message_parse_error(msg, &err, &debug);
+        event.type = Event::Type::Error;
+        event.text = std::string(GST_OBJECT_NAME(GST_MESSAGE_SRC(msg))) + ": "
+                   + (err ? err->message : "unknown error");
+        if (debug)
+            event.text += std::string(" (") + debug + ")";
+        g_clear_error(&err);
+        g_free(debug);
+        break;
+    }
+    case GST_MESSAGE_ASYNC_DONE:
+        event.type = Event::Type::AsyncDone;
+        break;
+    case GST_MESSAGE_STREAM_START:
+        event.type = Event::Type::StreamStart;
+        break;
+    case GST_MESSAGE_SEGMENT_DONE:
+        event.type = Event::Type::SegmentDone;
+        break;
+    case GST_MESSAGE_QOS:
+        context->self->add_qos(context->id, msg);
+        return GST_BUS_DROP;
+    case GST_MESSAGE_BUFFERING:
+        context->self->add_buffering(context->id, msg);
+        return GST_BUS_DROP;
+    default:
+        // Nobody pops this bus; dropping here keeps it from growing
+        return GST_BUS_DROP;
+    }
+
+    context->self->post(context->id, std::move(event));
+    return GST_BUS_DROP;
+}
+
+void BusDispatcher::post(guint64 id, Event event)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        urgent = urgent || event.type == Event::Type::SegmentDone;
+        pending.push_back({id, std::move(event)});
+    }
+    wake();
+}
+
+void BusDispatcher::add_qos(guint64 id, GstMessage* msg)
+{
+    GstFormat format;
+    guint64 processed = 0;
+    guint64 dropped = 0;
+    gint64 jitter = 0;
+    gst_message_parse_qos_stats(msg, &format, &processed, &dropped);
+    gst_message_parse_qos_values(msg, &jitter, nullptr, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& totals = qos[id];
+        totals.messages++;
+        if (format == GST_FORMAT_BUFFERS) {
+            // Counters are cumulative per element; report the latest
+            totals.frames = true;
+            totals.processed = processed;
+            totals.dropped = dropped;
+        } else if (format == GST_FORMAT_DEFAULT) {
+            totals.audio++;
+        }
+        if (jitter > 0) {
+            totals.lateness_us += jitter / 1000;
+            totals.late++;
+        }
+    }
+    wake();
+}
+
+void BusDispatcher::add_buffering(guint64 id, GstMessage* msg)
+{
+    gint percent = 100;
+    gst_message_parse_buffering(msg, &percent);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffering[id] = percent;
+    }
+    wake();
+}
+
+void BusDispatcher::wake()
+{
+    // One dispatcher write per batch, however many messages arrive
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (wake_pending && !urgent)
+            return;
+        wake_pending = true;
+    }
+    dispatcher.emit();
+}
+
+void BusDispatcher::on_dispatch()
+{
+    bool now = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(now, urgent);
+    }
+    if (now) {
+        flush_timer.disconnect();
+        flush();
+        return;
+    }
+    if (flush_timer.connected())
+        return;
+
+    gint64 wait_us = last_flush_us + min_interval_us - g_get_monotonic_time();
+    if (wait_us <= 0) {
+        flush();
+        return;
+    }
+    flush_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &BusDispatcher::flush),
+                                                 static_cast<unsigned>((wait_us + 999) / 1000));
+}
+
+bool BusDispatcher::flush()
+{
+    std::vector<Pending> batch;
+    std::map<guint64, QosTotals> qos_batch;
+    std::map<guint64, int> buffering_batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+        qos_batch.swap(qos);
+        buffering_batch.swap(buffering);
+        wake_pending = false;
+    }
+    last_flush_us = g_get_monotonic_time();
+
+    for (const auto& totals : qos_batch) {
+        Event event;
+        event.type = Event::Type::Qos;
+        event.qos_messages = totals.second.messages;
+        event.qos_frames = totals.second.frames;
+        event.qos_processed = totals.second.processed;
+        event.qos_dropped = totals.second.dropped;
+        event.qos_audio = totals.second.audio;
+        event.qos_lateness_us = totals.second.lateness_us;
+        event.qos_late = totals.second.late;
+        batch.push_back({totals.first, event});
+    }
+    for (const auto& latest : buffering_batch) {
+        Event event;
+        event.type = Event::Type::Buffering;
+        event.buffering_percent = latest.second;
+        batch.push_back({latest.first, event});
+    }
+
+    for (const auto& item : batch) {
+        // Looked up per event: a handler may unwatch (and free) a pipeline
+        Handler handler;
+        for (const auto& entry : watches) {
+            if (entry.second.id == item.id) {
+                handler = entry.second.handler;
+                break;
+            }
+        }
+        if (handler)
+            handler(item.event);
+    }
+    return false;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
+#include <gst/gst.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One owner for every cue pipeline's bus. Messages are filtered in a bus sync
+// handler on the posting (streaming) thread and never queued on the bus, so
+// state changes and tags cost nothing on the main loop.
+//
+// Only EOS, ERROR, ASYNC_DONE, STREAM_START, SEGMENT_DONE, QoS and BUFFERING
+// survive the filter. QoS and buffering are folded into one summary per
+// pipeline per flush. The main thread drains the queue at most `max_rate_hz`
+// times a second and delivers each batch in posting order; SEGMENT_DONE is
+// delivered at once, since a loop's next pass has to be queued in time.
+class BusDispatcher
+{
+public:
+    struct Event {
+        enum class Type { Eos, Error, AsyncDone, StreamStart, SegmentDone, Qos, Buffering };
+        Type type = Type::Eos;
+        std::string text;       // error / debug text
+        gint64 posted_us = 0;   // monotonic, when the pipeline posted it
+        guint64 qos_messages = 0;
+        bool qos_frames = false;     // processed/dropped were reported this flush
+        guint64 qos_processed = 0;   // video frames, cumulative per sink
+        guint64 qos_dropped = 0;
+        guint64 qos_audio = 0;       // messages from sinks counting samples
+        gint64 qos_lateness_us = 0;  // sum over this flush's late buffers
+        guint64 qos_late = 0;
+        int buffering_percent = 100;
+    };
+    using Handler = std::function<void(const Event&)>;
+
+    explicit BusDispatcher(unsigned max_rate_hz = 20);
+    ~BusDispatcher();
+
+    BusDispatcher(const BusDispatcher&) = delete;
+    BusDispatcher& operator=(const BusDispatcher&) = delete;
+
+    // Handler runs on the main thread; replaces any earlier watch on `pipeline`
+    void watch(GstElement* pipeline, Handler handler);
+    // Keeps the existing watch, so events already queued for `pipeline`, even
+    // later in the batch being flushed, reach the new handler
+    void set_handler(GstElement* pipeline, Handler handler);
+    // Call before the pipeline is freed; queued events for it are discarded
+    void unwatch(GstElement* pipeline);
+
+private:
+    struct Watch {
+        GstBus* bus = nullptr;
+        Handler handler;
+        guint64 id = 0;
+    };
+    struct SyncContext {
+        BusDispatcher* self;
+        guint64 id;
+    };
+    struct Pending {
+        guint64 id;
+        Event event;
+    };
+    struct QosTotals {
+        guint64 messages = 0;
+        guint64 processed = 0;
+        guint64 dropped = 0;
+        bool frames = false;
+        guint64 audio = 0;
+        gint64 lateness_us = 0;
+        guint64 late = 0;
+    };
+
+    static GstBusSyncReply on_sync_message(GstBus* bus, GstMessage* msg, gpointer user_data);
+    void post(guint64 id, Event event);
+    void add_qos(guint64 id, GstMessage* msg);
+    void add_buffering(guint64 id, GstMessage* msg);
+    void wake();
+    void on_dispatch();
+    bool flush();
+
+    gint64 min_interval_us;
+    gint64 last_flush_us = 0;
+    sigc::connection flush_timer;
+
+    std::map<GstElement*, Watch> watches;
+    guint64 next_id = 1;
+
+    std::mutex mutex;
+    std::vector<Pending> pending;
+    std::map<guint64, QosTotals> qos;
+    std::map<guint64, int> buffering; // latest percent
+    bool wake_pending = false;
+    bool urgent = false; // flush without waiting out the rate limit
+
+    Glib::Dispatcher dispatcher;
+};
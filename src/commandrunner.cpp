@@ -0,0 +1,277 @@
+#include "commandrunner.h"
+#include <glibmm/main.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+// Grace period between SIGTERM and SIGKILL
+constexpr int kill_delay_ms = 2000;
+
+}
+
+std::string CommandRunner::Result::describe() const
+{
+    if (cancelled)
+        return "Cancelled";
+    if (!started)
+        return "Failed to start";
+    if (timed_out)
+        return "Timed out";
+    if (signal != 0)
+        return "Signal " + std::to_string(signal);
+    if (exit_code == 0)
+        return "Done";
+    return "Exit " + std::to_string(exit_code);
+}
+
+CommandRunner::CommandRunner(unsigned max_running, size_t output_limit)
+: max_running(max_running > 0 ? max_running : 1),
+  output_limit(output_limit)
+{
+}
+
+CommandRunner::~CommandRunner()
+{
+    for (auto& entry : reports)
+        entry.second.disconnect();
+    for (auto& entry : running) {
+        Running& job = entry.second;
+        job.io_watch.disconnect();
+        job.child_watch.disconnect();
+        job.timeout.disconnect();
+        job.kill_timeout.disconnect();
+        kill(-job.pid, SIGKILL);
+        // The child watch is gone, so reap it here; SIGKILL makes this quick
+        waitpid(job.pid, nullptr, 0);
+        if (job.fd >= 0)
+            close(job.fd);
+    }
+}
+
+uint64_t CommandRunner::run(const std::string& command, int timeout_ms, Callback callback)
+{
+    uint64_t id = next_id++;
+    queued.push_back({id, command, timeout_ms, std::move(callback)});
+    start_queued();
+    return id;
+}
+
+void CommandRunner::cancel(uint64_t id)
+{
+    for (auto it = queued.begin(); it != queued.end(); ++it) {
+        if (it->id == id) {
+            Result cancelled;
+            cancelled.job = id;
+            cancelled.cancelled = true;
+            Callback callback = std::move(it->callback);
+            queued.erase(it);
+            // Report from the main loop, never from inside cancel()
+            report_later(std::move(callback), cancelled);
+            return;
+        }
+    }
+
+    auto it = running.find(id);
+    if (it == running.end() || it->second.result.cancelled)
+        return;
+    it->second.result.cancelled = true;
+    terminate(id);
+}
+
+void CommandRunner::set_max_running(unsigned new_max_running)
+{
+    if (new_max_running == 0)
+        return;
+    max_running = new_max_running;
+    start_queued();
+}
+
+void CommandRunner::start_queued()
+{
+    while (!queued.empty() && running.size() < max_running) {
+        Pending job = std::move(queued.front());
+        queued.pop_front();
+        start(std::move(job));
+    }
+}
+
+void CommandRunner::start(Pending pending)
+{
+    Result failed;
+    failed.job = pending.id;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        failed.output = std::string("pipe: ") + strerror(errno);
+    } else {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+
+        // Own process group, so a timeout also reaches whatever the shell started;
+        // signal dispositions and mask are reset to the defaults
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setpgroup(&attr, 0);
+        sigset_t mask;
+        sigemptyset(&mask);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        sigset_t defaults;
+        sigfillset(&defaults);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        pid_t pid = -1;
+        const char* argv[] = {"/bin/sh", "-c", pending.command.c_str(), nullptr};
+        int error = posix_spawn(&pid, "/bin/sh", &actions, &attr, const_cast<char* const*>(argv), environ);
+
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+
+        if (error == 0) {
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+            uint64_t id = pending.id;
+            Running& job = running[id];
+            job.pid = pid;
+            job.fd = fds[0];
+            job.result.job = id;
+            job.result.started = true;
+            job.callback = std::move(pending.callback);
+            job.io_watch = Glib::signal_io().connect(
+                sigc::bind(sigc::mem_fun(*this, &CommandRunner::on_output), id),
+                job.fd, Glib::IO_IN | Glib::IO_HUP | Glib::IO_ERR);
+            job.child_watch = Glib::signal_child_watch().connect(
+                sigc::bind(sigc::mem_fun(*this, &CommandRunner::on_exit), id), pid);
+            if (pending.timeout_ms > 0) {
+                job.timeout = Glib::signal_timeout().connect([this, id]() {
+                    auto it = running.find(id);
+                    if (it != running.end()) {
+                        it->second.result.timed_out = true;
+                        terminate(id);
+                    }
+                    return false;
+                }, pending.timeout_ms);
+            }
+            return;
+        }
+
+        close(fds[0]);
+        failed.output = std::string("posix_spawn: ") + strerror(error);
+    }
+
+    // Report from the main loop, never from inside run()
+    report_later(std::move(pending.callback), failed);
+}
+
+void CommandRunner::report_later(Callback callback, Result result)
+{
+    if (!callback)
+        return;
+    // Held so the destructor can drop it; the callback may outlive its owner
+    uint64_t id = result.job;
+    reports[id] = Glib::signal_idle().connect([this, id, callback, result]() {
+        reports.erase(id);
+        callback(result);
+        return false;
+    });
+}
+
+void CommandRunner::terminate(uint64_t id)
+{
+    auto it = running.find(id);
+    if (it == running.end() || it->second.kill_timeout.connected())
+        return;
+
+    Running& job = it->second;
+    job.timeout.disconnect();
+    kill(-job.pid, SIGTERM);
+    job.kill_timeout = Glib::signal_timeout().connect([this, id]() {
+        auto it = running.find(id);
+        if (it != running.end())
+            kill(-it->second.pid, SIGKILL);
+        return false;
+    }, kill_delay_ms);
+}
+
+bool CommandRunner::on_output(Glib::IOCondition /*condition*/, uint64_t id)
+{
+    auto it = running.find(id);
+    if (it == running.end())
+        return false;
+
+    Running& job = it->second;
+    read_output(job);
+    if (job.fd >= 0)
+        return true;
+    // EOF; the child watch finishes the job
+    return false;
+}
+
+void CommandRunner::read_output(Running& job)
+{
+    if (job.fd < 0)
+        return;
+
+    char buffer[4096];
+    for (;;) {
+        ssize_t n = read(job.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            std::string& output = job.result.output;
+            output.append(buffer, static_cast<size_t>(n));
+            // Keep the tail; that is where the error usually is
+            if (output.size() > output_limit) {
+                output.erase(0, output.size() - output_limit);
+                job.result.truncated = true;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        // EOF or a real error: nothing more will come
+        close(job.fd);
+        job.fd = -1;
+        return;
+    }
+}
+
+void CommandRunner::on_exit(GPid /*pid*/, int status, uint64_t id)
+{
+    auto it = running.find(id);
+    if (it == running.end())
+        return;
+
+    Running job = std::move(it->second);
+    running.erase(it);
+
+    // Whatever the shell wrote before exiting is already in the pipe.
+    // Background children may keep it open; they are not waited for.
+    read_output(job);
+    job.io_watch.disconnect();
+    job.timeout.disconnect();
+    job.kill_timeout.disconnect();
+    if (job.fd >= 0)
+        close(job.fd);
+
+    if (WIFEXITED(status))
+        job.result.exit_code = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        job.result.signal = WTERMSIG(status);
+
+    start_queued();
+    if (job.callback)
+        job.callback(job.result);
+}
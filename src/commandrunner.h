@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glibmm/main.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+// Runs control cue commands (`/bin/sh -c <command>`) without blocking the
+// GTK main loop. Processes are started with posix_spawn in their own process
+// group; stdout and stderr share one non-blocking pipe that is read from a
+// main loop IO watch, and GLib's child watch reaps the process. Callbacks run
+// on the main thread.
+//
+// At most max_running commands run at once; the rest wait in order. A
+// command that outlives its timeout gets SIGTERM, then SIGKILL.
+class CommandRunner
+{
+public:
+    struct Result {
+        uint64_t job = 0;
+        bool started = false;   // false: posix_spawn failed (output says why) or cancelled while queued
+        bool timed_out = false;
+        bool cancelled = false;
+        int exit_code = -1;     // when the shell exited normally
+        int signal = 0;         // when it was killed
+        std::string output;     // the last output_limit bytes of stdout and stderr
+        bool truncated = false;
+
+        bool ok() const { return started && exit_code == 0; }
+        // Short status for the cue row: "Done", "Exit 3", "Timed out", ...
+        std::string describe() const;
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    explicit CommandRunner(unsigned max_running = 4, size_t output_limit = 16 * 1024);
+    ~CommandRunner(); // kills whatever still runs, without callbacks, and drops pending reports
+
+    CommandRunner(const CommandRunner&) = delete;
+    CommandRunner& operator=(const CommandRunner&) = delete;
+
+    // timeout_ms <= 0 means no limit. Returns a job id, never 0.
+    uint64_t run(const std::string& command, int timeout_ms, Callback callback);
+    // A queued job is dropped and a running one terminated; either way its
+    // callback reports cancelled, from the main loop.
+    void cancel(uint64_t job);
+
+    void set_max_running(unsigned max_running);
+    unsigned get_max_running() const { return max_running; }
+
+private:
+    struct Pending {
+        uint64_t id;
+        std::string command;
+        int timeout_ms;
+        Callback callback;
+    };
+    struct Running {
+        pid_t pid = -1;
+        int fd = -1;
+        Result result;
+        Callback callback;
+        sigc::connection io_watch;
+        sigc::connection child_watch;
+        sigc::connection timeout;
+        sigc::connection kill_timeout;
+    };
+
+    void start(Pending job);
+    void start_queued();
+    bool on_output(Glib::IOCondition condition, uint64_t id);
+    void read_output(Running& job);
+    void on_exit(GPid pid, int status, uint64_t id);
+    void terminate(uint64_t id);
+    // Calls back from an idle handler, dropped if the runner goes first
+    void report_later(Callback callback, Result result);
+
+    unsigned max_running;
+    size_t output_limit;
+    uint64_t next_id = 1;
+    std::deque<Pending> queued;
+    std::map<uint64_t, Running> running;
+    std::map<uint64_t, sigc::connection> reports; // by job, until the idle runs
+};
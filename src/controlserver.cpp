@@ -0,0 +1,410 @@
+#include "controlserver.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// A client that sends this much without a newline is dropped
+constexpr size_t max_line = 4096;
+// A client that does not read its replies and events is dropped
+constexpr size_t max_pending_output = 256 * 1024;
+
+std::string trim(const std::string& text)
+{
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return std::string();
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool parse_command(const std::string& text, ControlServer::Command& command)
+{
+    std::string rest = trim(text);
+    if (rest.empty())
+        return false;
+
+    size_t pos = 0;
+    while (pos < rest.size()) {
+        size_t end = rest.find_first_of(" \t", pos);
+        if (end == std::string::npos)
+            end = rest.size();
+        if (end > pos) {
+            std::string word = rest.substr(pos, end - pos);
+            if (command.verb.empty()) {
+                std::transform(word.begin(), word.end(), word.begin(),
+                               [](unsigned char c) { return static_cast<char>(g_ascii_toupper(c)); });
+                command.verb = std::move(word);
+            } else {
+                command.args.push_back(std::move(word));
+            }
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+}
+
+ControlServer::ControlServer()
+{
+    dispatcher.connect(sigc::mem_fun(*this, &ControlServer::on_dispatch));
+}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+std::string ControlServer::default_path()
+{
+    if (const char* override_path = g_getenv("STAGESHOW_CONTROL_SOCKET"))
+        return override_path;
+    gchar* socket_path = g_build_filename(g_get_user_runtime_dir(), "linux-stageshow.sock", nullptr);
+    std::string result(socket_path);
+    g_free(socket_path);
+    return result;
+}
+
+bool ControlServer::start(const std::string& socket_path, Handler new_handler)
+{
+    stop();
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Control socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Control socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // A socket left behind by a crashed instance refuses connections
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        bool in_use = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        close(probe);
+        if (in_use) {
+            std::cerr << "Control socket already in use: " << socket_path << std::endl;
+            close(fd);
+            return false;
+        }
+    }
+    // Only ever a stale socket; any other file at the path is not ours to delete
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "Control socket path exists and is not a socket: " << socket_path << std::endl;
+            close(fd);
+            return false;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    mode_t old_mask = umask(0077);
+    int bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+    if (bound != 0 || listen(fd, 8) != 0) {
+        std::cerr << "Control socket " << socket_path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        std::cerr << "Control socket eventfd: " << strerror(errno) << std::endl;
+        close(fd);
+        unlink(socket_path.c_str());
+        return false;
+    }
+
+    listen_fd = fd;
+    path = socket_path;
+    handler = std::move(new_handler);
+    stopping = false;
+    thread = std::thread(&ControlServer::thread_main, this);
+    std::cout << "Control socket listening on " << path << "\n";
+    return true;
+}
+
+void ControlServer::stop()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake();
+    thread.join();
+
+    for (auto& entry : clients)
+        close(entry.second.fd);
+    clients.clear();
+    close(listen_fd);
+    close(wake_fd);
+    listen_fd = wake_fd = -1;
+    unlink(path.c_str());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    commands.clear();
+    outbox.clear();
+    subscribers.clear();
+}
+
+void ControlServer::wake()
+{
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n; // EAGAIN: a wakeup is already pending
+}
+
+void ControlServer::notify(const std::string& event)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (subscribers.empty())
+            return;
+        for (uint64_t id : subscribers)
+            outbox[id] += "EVENT " + event + "\n";
+    }
+    wake();
+}
+
+void ControlServer::thread_main()
+{
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+
+    for (;;) {
+        // Pick up replies and events queued by the main thread
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            for (auto& entry : outbox) {
+                auto it = clients.find(entry.first);
+                if (it != clients.end())
+                    it->second.out += entry.second;
+                else
+                    subscribers.erase(entry.first); // subscribed after it left
+            }
+            outbox.clear();
+        }
+
+        fds.clear();
+        ids.clear();
+        fds.push_back({wake_fd, POLLIN, 0});
+        fds.push_back({listen_fd, POLLIN, 0});
+        for (auto& entry : clients) {
+            short events = POLLIN;
+            if (!entry.second.out.empty())
+                events |= POLLOUT;
+            fds.push_back({entry.second.fd, events, 0});
+            ids.push_back(entry.first);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Control socket poll: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            ssize_t n = read(wake_fd, &count, sizeof(count));
+            (void)n;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            for (;;) {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                    break;
+                clients[next_client++].fd = fd;
+            }
+        }
+
+        // Every command read in this round is one batch for the main thread
+        std::vector<Command> batch;
+        std::vector<uint64_t> dropped;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            short revents = fds[i + 2].revents;
+            if (!revents)
+                continue;
+            Client& client = clients[ids[i]];
+            bool alive = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+                alive = read_client(ids[i], client, batch);
+            if (alive && (revents & POLLOUT))
+                alive = write_client(client);
+            if (!alive)
+                dropped.push_back(ids[i]);
+        }
+
+        for (uint64_t id : dropped) {
+            close(clients[id].fd);
+            clients.erase(id);
+        }
+
+        if (!batch.empty() || !dropped.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (uint64_t id : dropped) {
+                    subscribers.erase(id);
+                    outbox.erase(id);
+                }
+                for (auto& command : batch)
+                    commands.push_back(std::move(command));
+            }
+            if (!batch.empty())
+                dispatcher.emit();
+        }
+    }
+}
+
+bool ControlServer::read_client(uint64_t id, Client& client, std::vector<Command>& batch)
+{
+    char buffer[4096];
+    bool open = true;
+    for (;;) {
+        ssize_t n = read(client.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            client.in.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        open = false; // EOF or error; still run what arrived
+        break;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    size_t start = 0;
+    for (;;) {
+        size_t newline = client.in.find('\n', start);
+        if (newline == std::string::npos)
+            break;
+        std::string line = client.in.substr(start, newline - start);
+        start = newline + 1;
+
+        size_t pos = 0;
+        while (pos <= line.size()) {
+            size_t end = line.find(';', pos);
+            if (end == std::string::npos)
+                end = line.size();
+            Command command;
+            command.client = id;
+            command.received_us = now;
+            if (parse_command(line.substr(pos, end - pos), command))
+                batch.push_back(std::move(command));
+            pos = end + 1;
+        }
+    }
+    client.in.erase(0, start);
+
+    if (client.in.size() > max_line) {
+        std::cerr << "Control client sent an over-long line, dropping it" << std::endl;
+        return false;
+    }
+    return open;
+}
+
+bool ControlServer::write_client(Client& client)
+{
+    while (!client.out.empty()) {
+        ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            client.out.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return false;
+    }
+    if (client.out.size() > max_pending_output) {
+        std::cerr << "Control client is not reading, dropping it" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::on_dispatch()
+{
+    std::deque<Command> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(commands);
+    }
+    if (ready.empty())
+        return;
+
+    // Replies go out together once the whole batch has run
+    std::map<uint64_t, std::string> replies;
+    for (const auto& command : ready) {
+        replies[command.client] += handle(command) + "\n";
+        trace_complete("control command", 0, command.received_us);
+
+        gint64 latency = g_get_monotonic_time() - command.received_us;
+        stats.commands++;
+        stats.total_us += latency;
+        stats.max_us = std::max(stats.max_us, latency);
+        if (latency > budget_us) {
+            stats.over_budget++;
+            std::cerr << "Control command " << command.verb << " took "
+                      << latency / 1000.0 << " ms" << std::endl;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : replies)
+            outbox[entry.first] += entry.second;
+    }
+    wake();
+}
+
+std::string ControlServer::handle(const Command& command)
+{
+    if (command.verb == "SUBSCRIBE" || command.verb == "UNSUBSCRIBE") {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (command.verb == "SUBSCRIBE")
+            subscribers.insert(command.client);
+        else
+            subscribers.erase(command.client);
+        return "OK";
+    }
+    if (command.verb == "STATS") {
+        gint64 average = stats.commands ? stats.total_us / static_cast<gint64>(stats.commands) : 0;
+        return "OK commands=" + std::to_string(stats.commands) +
+               " avg_us=" + std::to_string(average) +
+               " max_us=" + std::to_string(stats.max_us) +
+               " over_budget=" + std::to_string(stats.over_budget);
+    }
+    if (command.verb == "PING")
+        return "OK PONG";
+    if (!handler)
+        return "ERR no handler";
+    return handler(command);
+}
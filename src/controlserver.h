@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glibmm/dispatcher.h>
+#include <glib.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Line-based remote control on a Unix domain socket, for stage management
+// and lighting desks that fire cues without touching the window.
+//
+// A client sends one command per line; several commands on one line,
+// separated by ';', form a batch that runs in a single main loop dispatch.
+// Every command gets one reply line in order, "OK [...]" or "ERR <reason>".
+// SUBSCRIBE makes the server push "EVENT ..." lines to the client until
+// UNSUBSCRIBE or disconnect.
+//
+// Sockets are serviced by one poll() thread; commands are handed to the main
+// thread through a Glib::Dispatcher, so the handler may touch GTK and
+// GStreamer. Receive-to-handled latency is recorded for every command.
+class ControlServer
+{
+public:
+    struct Command {
+        uint64_t client = 0;
+        std::string verb;               // upper-cased
+        std::vector<std::string> args;
+        gint64 received_us = 0;         // monotonic, when the line was read
+    };
+    // Runs on the main thread; returns the reply line without the newline
+    using Handler = std::function<std::string(const Command&)>;
+
+    struct Stats {
+        uint64_t commands = 0;
+        gint64 total_us = 0;
+        gint64 max_us = 0;
+        uint64_t over_budget = 0;       // slower than budget_us
+    };
+    static constexpr gint64 budget_us = 5000;
+
+    ControlServer();
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Binds `path`, replacing a stale socket; false if it cannot listen
+    bool start(const std::string& path, Handler handler);
+    void stop();
+    bool is_running() const { return thread.joinable(); }
+
+    // Sends "EVENT <event>" to every subscriber. Main thread.
+    void notify(const std::string& event);
+    const Stats& get_stats() const { return stats; }
+
+    // $STAGESHOW_CONTROL_SOCKET, or $XDG_RUNTIME_DIR/linux-stageshow.sock
+    static std::string default_path();
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string in;
+        std::string out;
+    };
+
+    void thread_main();
+    bool read_client(uint64_t id, Client& client, std::vector<Command>& batch);
+    bool write_client(Client& client);
+    void wake();
+    void on_dispatch();
+    std::string handle(const Command& command);
+
+    Handler handler;
+    std::string path;
+    int listen_fd = -1;
+    int wake_fd = -1;
+    std::thread thread;
+
+    // Owned by the socket thread
+    std::map<uint64_t, Client> clients;
+    uint64_t next_client = 1;
+
+    // Shared with the socket thread
+    std::mutex mutex;
+    std::deque<Command> commands;
+    std::map<uint64_t, std::string> outbox;
+    std::set<uint64_t> subscribers;
+    bool stopping = false;
+
+    // Main thread only
+    Stats stats;
+
+    Glib::Dispatcher dispatcher;
+};
@@ -0,0 +1,986 @@
+#include "cueengine.h"
+#include "fade.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+CueEngine::CueEngine(std::shared_ptr<CueScheduler> cue_scheduler, const std::string& audio_sink_factory)
+: scheduler(std::move(cue_scheduler)),
+  audio_sink(audio_sink_factory),
+  audio_engine(8, 48000, 2, audio_sink_factory)
+{
+}
+
+CueEngine::~CueEngine()
+{
+    // Views may already be half torn down
+    listener = Listener();
+    output = Output();
+    release_all();
+}
+
+void CueEngine::set_output(Output new_output)
+{
+    output = std::move(new_output);
+}
+
+void CueEngine::set_listener(Listener new_listener)
+{
+    listener = std::move(new_listener);
+}
+
+bool CueEngine::is_paused(const std::shared_ptr<CueItem>& cue) const
+{
+    return cue->gst_pipeline && !cue->standby && GST_STATE(cue->gst_pipeline) == GST_STATE_PAUSED;
+}
+
+void CueEngine::notify_state_changed()
+{
+    if (listener.state_changed)
+        listener.state_changed();
+}
+
+void CueEngine::show_fallback()
+{
+    if (output.show_fallback)
+        output.show_fallback();
+}
+
+void CueEngine::go(std::shared_ptr<CueItem> cue)
+{
+    if (!cue)
+        return;
+
+    TraceSpan span("GO", cue->id);
+    active_cue = cue;
+    notify_state_changed();
+
+    switch (cue->type) {
+    case CueItem::Type::Audio:
+        start_audio_cue(cue);
+        break;
+    case CueItem::Type::Video:
+        start_video_cue(cue);
+        break;
+    case CueItem::Type::Slideshow:
+        if (output.start_slideshow)
+            output.start_slideshow(cue);
+        start_slideshow_cue(cue);
+        break;
+    case CueItem::Type::Control:
+        start_command_cue(cue);
+        break;
+    default:
+        show_fallback();
+        std::cerr << "Unhandled cue type for " << cue->name << std::endl;
+        break;
+    }
+}
+
+void CueEngine::start_slideshow_cue(std::shared_ptr<CueItem> cue)
+{
+    if (cue->slideshow_images.empty())
+        return;
+
+    cue->slideshow_position = 0;
+    if (listener.slide_changed)
+        listener.slide_changed(cue);
+
+    auto first_image = cue->slideshow_images.front();
+
+    if (cue->prewait > 0) {
+        scheduler->schedule(cue->prewait * 1000,
+            [this, first_image]() {
+                if (output.show_slide)
+                    output.show_slide(first_image);
+            },
+            cue->id, CueScheduler::Wait::Prewait
+        );
+    } else if (output.show_slide) {
+        output.show_slide(first_image);
+    }
+
+    std::cout << "Started slideshow cue: " << cue->name << "\n";
+}
+
+void CueEngine::start_video_cue(std::shared_ptr<CueItem> cue)
+{
+    // Reuse the pre-rolled standby pipeline, otherwise start from scratch
+    if (cue->gst_pipeline && !cue->standby)
+        release(cue);
+    cue->go_from_standby = cue->standby;
+    cue->standby = false;
+    if (standby_cue == cue)
+        standby_cue.reset();
+
+    if (!cue->gst_pipeline) {
+        cue->health.reset();
+        cue->gst_pipeline = build_cue_pipeline(cue, cue->audio_input, cue->fader);
+    }
+    if (!cue->gst_pipeline)
+        return;
+
+    // A loop pre-rolls first to be armed (see arm_loop)
+    if (cue->loop_forever && !cue->go_from_standby) {
+        TraceSpan span("set_state PAUSED", cue->id);
+        trace_async_begin("preroll", cue->id);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_PAUSED);
+    }
+
+    // Play with optional delay
+    if (cue->prewait > 0) {
+        scheduler->schedule(cue->prewait * 1000,
+            [this, cue]() {
+                play_cue_pipeline(cue);
+            },
+            cue->id, CueScheduler::Wait::Prewait
+        );
+    } else {
+        play_cue_pipeline(cue);
+    }
+
+    std::cout << "Started video cue: " << cue->path_or_command << "\n";
+}
+
+void CueEngine::start_command_cue(std::shared_ptr<CueItem> cue)
+{
+    // Run with optional delay
+    if (cue->prewait > 0) {
+        scheduler->schedule(cue->prewait * 1000,
+            [this, cue]() {
+                run_command(cue, true);
+            },
+            cue->id, CueScheduler::Wait::Prewait
+        );
+    } else {
+        run_command(cue, true);
+    }
+    std::cout << "Started command cue: " << cue->path_or_command << "\n";
+}
+
+void CueEngine::run_command(std::shared_ptr<CueItem> cue, bool finish_cue)
+{
+    if (cue->path_or_command.empty())
+        return;
+
+    // Triggering a cue again restarts its command
+    if (cue->command_job)
+        command_runner.cancel(cue->command_job);
+
+    trace_async_begin("command", cue->id);
+    std::weak_ptr<CueItem> weak_cue = cue;
+    cue->command_job = command_runner.run(cue->path_or_command, cue->command_timeout * 1000,
+        [this, weak_cue, finish_cue](const CommandRunner::Result& result) {
+            if (auto cue = weak_cue.lock())
+                on_command_done(cue, finish_cue, result);
+        });
+
+    running_cues.insert(cue);
+    notify_state_changed();
+    if (listener.cue_status)
+        listener.cue_status(cue, "Running");
+    if (listener.cue_started)
+        listener.cue_started(cue);
+}
+
+void CueEngine::on_command_done(std::shared_ptr<CueItem> cue, bool finish_cue, const CommandRunner::Result& result)
+{
+    // A newer run of the same cue owns the row now
+    if (result.job != cue->command_job)
+        return;
+    cue->command_job = 0;
+    trace_async_end("command", cue->id);
+
+    if (!result.ok()) {
+        std::cerr << "Command cue " << cue->name << ": " << result.describe() << std::endl;
+        if (!result.output.empty())
+            std::cerr << (result.truncated ? "..." : "") << result.output << std::endl;
+        if (listener.cue_failed && !result.cancelled)
+            listener.cue_failed(cue, result.describe());
+    }
+
+    if (listener.cue_stopped)
+        listener.cue_stopped(cue);
+    if (listener.cue_status)
+        listener.cue_status(cue, result.describe());
+    if (running_cues.erase(cue))
+        notify_state_changed();
+
+    if (!finish_cue || result.cancelled)
+        return;
+
+    // The cue is over once the command exits and the post-wait has passed
+    std::weak_ptr<CueItem> weak_cue = cue;
+    scheduler->schedule(cue->postwait * 1000, [this, weak_cue]() {
+        auto cue = weak_cue.lock();
+        if (cue && cue == active_cue)
+            on_cue_finished();
+    }, cue->id, CueScheduler::Wait::Postwait);
+}
+
+void CueEngine::start_audio_cue(std::shared_ptr<CueItem> cue)
+{
+    // Reuse the pre-rolled standby pipeline, otherwise start from scratch
+    if (cue->gst_pipeline && !cue->standby)
+        release(cue);
+    cue->go_from_standby = cue->standby;
+    cue->standby = false;
+    if (standby_cue == cue)
+        standby_cue.reset();
+
+    if (!cue->gst_pipeline) {
+        cue->health.reset();
+        cue->gst_pipeline = build_cue_pipeline(cue, cue->audio_input, cue->fader);
+    }
+    if (!cue->gst_pipeline)
+        return;
+
+    // A loop pre-rolls first to be armed (see arm_loop)
+    if (cue->loop_forever && !cue->go_from_standby) {
+        TraceSpan span("set_state PAUSED", cue->id);
+        trace_async_begin("preroll", cue->id);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_PAUSED);
+    }
+
+    // Handle prewait; the pipeline starts on the timer thread, on time,
+    // unless it is a loop, which is armed and started on the main thread
+    if (cue->prewait > 0) {
+        bool on_time = !cue->loop_forever;
+        scheduler->schedule(cue->prewait * 1000,
+            [this, cue, on_time]() {
+                play_cue_pipeline(cue, on_time);
+            },
+            cue->id, CueScheduler::Wait::Prewait, on_time ? start_on_time(cue) : nullptr
+        );
+    } else {
+        play_cue_pipeline(cue);
+    }
+
+    std::cout << "Started audio cue: " << cue->path_or_command << "\n";
+}
+
+GstElement* CueEngine::build_cue_pipeline(std::shared_ptr<CueItem> cue, int& audio_input, GstElement*& fader)
+{
+    TraceSpan span("build pipeline", cue->id);
+    GstElement* pipeline = gst_element_factory_make("playbin", nullptr);
+    if (!pipeline) {
+        std::cerr << "Failed to create playbin for cue: " << cue->name << std::endl;
+        return nullptr;
+    }
+
+    // Audio goes through the shared mixer, on the mixer's clock
+    GstElement* audio_sink_element = audio_engine.create_cue_sink(audio_input);
+    if (!audio_sink_element)
+        audio_sink_element = gst_element_factory_make(audio_sink.c_str(), nullptr);
+    GstElement* probe_sink = audio_sink_element;
+    if (audio_sink_element && GST_IS_BIN(audio_sink_element)) {
+        // Owned by the pipeline from here on, so no ref is kept
+        fader = gst_bin_get_by_name(GST_BIN(audio_sink_element), "fader");
+        if (fader)
+            gst_object_unref(fader);
+    }
+    g_object_set(pipeline, "audio-sink", audio_sink_element, nullptr);
+    audio_engine.use_clock(pipeline);
+
+    if (cue->type == CueItem::Type::Video) {
+        // Renders into a layer of the persistent program output
+        GstElement* video_sink = nullptr;
+        if (output.create_video_sink) {
+            video_sink = output.create_video_sink(cue->output_layer);
+            if (!video_sink) {
+                // Every output layer is taken; playbin would open a window of its own
+                std::cerr << "No free output layer for cue: " << cue->name << std::endl;
+                gst_object_unref(pipeline);
+                audio_engine.release_input(audio_input);
+                audio_input = -1;
+                fader = nullptr;
+                if (listener.cue_failed)
+                    listener.cue_failed(cue, "no free output layer");
+                return nullptr;
+            }
+        } else {
+            video_sink = gst_element_factory_make("fakesink", nullptr);
+            if (video_sink)
+                g_object_set(video_sink, "sync", TRUE, nullptr);
+        }
+        g_object_set(pipeline, "video-sink", video_sink, nullptr);
+        probe_sink = video_sink;
+    }
+
+    g_object_set(pipeline, "uri", ("file://" + cue->path_or_command).c_str(), nullptr);
+    g_object_set(pipeline, "volume", 1.0, nullptr);
+
+    // Probes and signals reach the cue through the context, which follows the
+    // pipeline through gapless hand-offs
+    auto* context = new PipelineContext;
+    context->cue = cue.get();
+    g_object_set_data_full(G_OBJECT(pipeline), "stageshow-context", context,
+                           [](gpointer data) { delete static_cast<PipelineContext*>(data); });
+
+    // Measure GO-to-first-buffer and count what reaches the sink that
+    // matters for this cue
+    if (probe_sink) {
+        GstPad* pad = gst_element_get_static_pad(probe_sink, "sink");
+        if (pad) {
+            gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                              &CueEngine::on_sink_buffer_probe, context, nullptr);
+            gst_object_unref(pad);
+        }
+    }
+    // Decoders are plugged while pre-rolling; time the ones feeding that sink
+    g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(&CueEngine::on_element_added), context);
+    g_signal_connect(pipeline, "about-to-finish", G_CALLBACK(&CueEngine::on_about_to_finish), context);
+
+    bus_dispatcher.watch(pipeline, bus_handler(pipeline, cue));
+    return pipeline;
+}
+
+BusDispatcher::Handler CueEngine::bus_handler(GstElement* pipeline, std::shared_ptr<CueItem> cue)
+{
+    // Only EOS/ERROR/ASYNC_DONE/STREAM_START/QoS/BUFFERING reach us, batched
+    // on the main thread
+    std::weak_ptr<CueItem> weak_cue = cue;
+    return [this, weak_cue, pipeline](const BusDispatcher::Event& event) {
+        if (auto cue = weak_cue.lock())
+            on_cue_bus_event(cue, pipeline, event);
+    };
+}
+
+CueEngine::PipelineContext* CueEngine::context_of(GstElement* pipeline)
+{
+    if (!pipeline)
+        return nullptr;
+    return static_cast<PipelineContext*>(g_object_get_data(G_OBJECT(pipeline), "stageshow-context"));
+}
+
+void CueEngine::arm_chain(const std::shared_ptr<CueItem>& cue)
+{
+    auto* context = context_of(cue->gst_pipeline);
+    if (!context)
+        return;
+
+    // Same kind of media, no prewait to honour, and not already playing
+    auto next = cue->auto_next && !cue->loop_forever ? cue_list.next(cue->id) : nullptr;
+    bool gapless = next && next != cue && next->type == cue->type && next->prewait == 0 && !next->loop_forever
+                && !next->path_or_command.empty() && (!next->gst_pipeline || next->standby);
+
+    std::lock_guard<std::mutex> lock(context->mutex);
+    if (gapless) {
+        context->next_uri = "file://" + next->path_or_command;
+        context->next_id = next->id;
+    } else {
+        context->next_uri.clear();
+        context->next_id = 0;
+    }
+}
+
+void CueEngine::on_about_to_finish(GstElement* playbin, gpointer user_data)
+{
+    // Runs on a streaming thread once the current file is fully read; the
+    // new uri plays on the same sinks right after the last queued sample
+    auto* context = static_cast<PipelineContext*>(user_data);
+    std::lock_guard<std::mutex> lock(context->mutex);
+    if (context->next_uri.empty())
+        return;
+    g_object_set(playbin, "uri", context->next_uri.c_str(), nullptr);
+    context->queued_id = context->next_id;
+    context->next_uri.clear();
+    context->next_id = 0;
+}
+
+void CueEngine::hand_off(std::shared_ptr<CueItem> from, std::shared_ptr<CueItem> to)
+{
+    TraceSpan span("gapless hand-off", to->id);
+    trace_instant("handed off", from->id);
+
+    // The queued cue's own standby pipeline is not needed any more
+    if (standby_cue == to)
+        release_standby();
+    else if (to->gst_pipeline)
+        release(to);
+
+    if (listener.cue_stopped)
+        listener.cue_stopped(from);
+    running_cues.erase(from);
+
+    to->gst_pipeline = from->gst_pipeline;
+    to->fader = from->fader;
+    to->output_layer = from->output_layer;
+    to->audio_input = from->audio_input;
+    to->go_from_standby = false;
+    from->gst_pipeline = nullptr;
+    from->fader = nullptr;
+    from->output_layer = -1;
+    from->audio_input = -1;
+
+    to->health.reset();
+    context_of(to->gst_pipeline)->cue = to.get();
+    // A new watch would drop the rest of this flush's events for the pipeline
+    bus_dispatcher.set_handler(to->gst_pipeline, bus_handler(to->gst_pipeline, to));
+
+    if (from == active_cue)
+        active_cue = to;
+    running_cues.insert(to);
+    notify_state_changed();
+    if (listener.cue_started)
+        listener.cue_started(to);
+    arm_chain(to);
+}
+
+void CueEngine::cues_changed()
+{
+    for (const auto& cue : running_cues) {
+        if (cue->gst_pipeline)
+            arm_chain(cue);
+    }
+}
+
+void CueEngine::cue_edited(std::shared_ptr<CueItem> cue)
+{
+    // The file, fade or loop may have changed under the pre-rolled pipeline
+    if (cue && cue == standby_cue && cue->standby) {
+        release_standby();
+        set_standby(cue);
+    }
+    cues_changed();
+}
+
+void CueEngine::on_cue_bus_event(std::shared_ptr<CueItem> cue, GstElement* pipeline, const BusDispatcher::Event& event)
+{
+    if (pipeline != cue->gst_pipeline) {
+        on_partner_bus_event(cue, event);
+        return;
+    }
+
+    switch (event.type) {
+    case BusDispatcher::Event::Type::AsyncDone:
+        trace_async_end("preroll", cue->id, event.posted_us);
+        if (cue->loop_forever && !cue->loop_armed) {
+            arm_loop(cue);
+            return;
+        }
+        if (cue->play_when_armed) {
+            cue->play_when_armed = false;
+            set_playing(cue);
+            return;
+        }
+        if (cue->standby)
+            trace_instant("standby ready", cue->id, event.posted_us);
+        return;
+    case BusDispatcher::Event::Type::SegmentDone:
+        loop_again(cue);
+        return;
+    case BusDispatcher::Event::Type::StreamStart: {
+        // Also posted when the cue's own media starts; only a queued cue hands off
+        auto* context = context_of(cue->gst_pipeline);
+        if (!context)
+            return;
+        uint64_t queued = 0;
+        {
+            std::lock_guard<std::mutex> lock(context->mutex);
+            std::swap(queued, context->queued_id);
+        }
+        auto next = queued ? cue_list.find(queued) : nullptr;
+        if (next)
+            hand_off(cue, next);
+        return;
+    }
+    case BusDispatcher::Event::Type::Qos: {
+        CueHealth& health = cue->health;
+        if (event.qos_frames) {
+            if (event.qos_dropped > health.frames_dropped)
+                std::cerr << "Cue " << cue->name << ": " << event.qos_messages << " QoS messages, "
+                          << event.qos_dropped << "/" << event.qos_processed << " frames dropped" << std::endl;
+            health.frames_processed = std::max(health.frames_processed, event.qos_processed);
+            health.frames_dropped = std::max(health.frames_dropped, event.qos_dropped);
+        }
+        health.audio_qos += event.qos_audio;
+        health.lateness_total_us += event.qos_lateness_us;
+        health.lateness_count += event.qos_late;
+        return;
+    }
+    case BusDispatcher::Event::Type::Buffering:
+        cue->health.buffering_percent = event.buffering_percent;
+        return;
+    case BusDispatcher::Event::Type::Error:
+        std::cerr << "Cue " << cue->name << " failed: " << event.text << std::endl;
+        trace_instant("error", cue->id, event.posted_us);
+        if (listener.cue_failed)
+            listener.cue_failed(cue, event.text);
+        break;
+    case BusDispatcher::Event::Type::Eos:
+        trace_instant("EOS", cue->id, event.posted_us);
+        break;
+    }
+
+    // EOS or ERROR: the cue is over
+    if (listener.cue_stopped)
+        listener.cue_stopped(cue);
+    running_cues.erase(cue);
+    notify_state_changed();
+    // The held frame is read from the layer's sink while it still has one
+    bool held = cue->type == CueItem::Type::Video && cue->last_frame
+             && event.type == BusDispatcher::Event::Type::Eos
+             && output.hold_video_layer && output.hold_video_layer(cue->output_layer);
+    if (held)
+        cue->output_layer = -1;
+
+    // Inter sinks clear their channel as they stop, so the pipeline goes
+    // before its mixer input and layer can be handed to another cue
+    {
+        TraceSpan span("set_state NULL", cue->id);
+        bus_dispatcher.unwatch(cue->gst_pipeline);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
+        gst_object_unref(cue->gst_pipeline);
+        cue->gst_pipeline = nullptr;
+        cue->fader = nullptr;
+    }
+    audio_engine.release_input(cue->audio_input);
+    cue->audio_input = -1;
+    if (cue->type == CueItem::Type::Video && !held) {
+        if (output.release_video_layer)
+            output.release_video_layer(cue->output_layer);
+        cue->output_layer = -1;
+        show_fallback();
+    }
+    if (cue == active_cue)
+        on_cue_finished();
+}
+
+void CueEngine::release(std::shared_ptr<CueItem> cue)
+{
+    scheduler->cancel_owner(cue->id);
+    // The cancelled job reports back and clears command_job
+    if (cue->command_job)
+        command_runner.cancel(cue->command_job);
+    if (cue->gst_pipeline) {
+        TraceSpan span("set_state NULL", cue->id);
+        if (listener.cue_stopped)
+            listener.cue_stopped(cue);
+        bus_dispatcher.unwatch(cue->gst_pipeline);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
+        gst_object_unref(cue->gst_pipeline);
+        cue->gst_pipeline = nullptr;
+    }
+    cue->fader = nullptr;
+    release_partner(cue);
+    cue->loop_armed = false;
+    cue->play_when_armed = false;
+    if (cue->output_layer >= 0) {
+        if (output.release_video_layer)
+            output.release_video_layer(cue->output_layer);
+        cue->output_layer = -1;
+    }
+    if (cue->audio_input >= 0) {
+        audio_engine.release_input(cue->audio_input);
+        cue->audio_input = -1;
+    }
+    cue->standby = false;
+    if (running_cues.erase(cue))
+        notify_state_changed();
+}
+
+void CueEngine::play_cue_pipeline(std::shared_ptr<CueItem> cue, bool started)
+{
+    if (!cue || !cue->gst_pipeline)
+        return;
+
+    // The layer already holds the pre-rolled frame; reveal it as playback starts
+    if (cue->type == CueItem::Type::Video && output.show_video_layer)
+        output.show_video_layer(cue->output_layer);
+
+    if (!started) {
+        cue->go_time_us = g_get_monotonic_time();
+        // A cold pipeline pre-rolls on its way to PLAYING; a loop already has
+        if (!cue->go_from_standby && !cue->loop_forever)
+            trace_async_begin("preroll", cue->id);
+        if (cue->loop_forever && !cue->loop_armed)
+            cue->play_when_armed = true;
+        else
+            set_playing(cue);
+    }
+    running_cues.insert(cue);
+    notify_state_changed();
+    if (listener.cue_started)
+        listener.cue_started(cue);
+    arm_chain(cue);
+}
+
+void CueEngine::set_playing(const std::shared_ptr<CueItem>& cue)
+{
+    {
+        TraceSpan span("set_state PLAYING", cue->id);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
+    }
+    if (cue->loop_partner)
+        schedule_loop_crossfade(cue);
+}
+
+void CueEngine::arm_loop(const std::shared_ptr<CueItem>& cue)
+{
+    cue->loop_armed = true;
+    gint64 duration = 0;
+    if (!gst_element_query_duration(cue->gst_pipeline, GST_FORMAT_TIME, &duration))
+        duration = 0;
+
+    GstClockTime crossfade = static_cast<GstClockTime>(cue->loop_crossfade_ms) * GST_MSECOND;
+    bool crossfaded = cue->type == CueItem::Type::Audio && crossfade > 0
+                   && duration >= static_cast<gint64>(2 * crossfade + GST_SECOND);
+    if (crossfaded) {
+        // Built once; the two pipelines take turns for as long as the loop runs
+        cue->loop_partner = build_cue_pipeline(cue, cue->partner_input, cue->partner_fader);
+        if (cue->loop_partner) {
+            cue->loop_duration = static_cast<GstClockTime>(duration);
+            arm_loop_crossfade(cue, crossfade);
+            fade_set(cue->partner_fader, 0.0);
+            gst_element_set_state(cue->loop_partner, GST_STATE_PAUSED);
+        } else {
+            crossfaded = false;
+        }
+    }
+
+    if (!crossfaded) {
+        // Flushing once, here, so later passes can be queued without a flush
+        TraceSpan span("loop seek", cue->id);
+        bool seeking = gst_element_seek(cue->gst_pipeline, 1.0, GST_FORMAT_TIME,
+                                        static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_SEGMENT
+                                                                  | GST_SEEK_FLAG_ACCURATE),
+                                        GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+        // The seek pre-rolls again; its ASYNC_DONE starts a GO that came meanwhile
+        if (seeking)
+            return;
+        std::cerr << "Cue " << cue->name << ": cannot seek, it will play once" << std::endl;
+    }
+
+    if (cue->play_when_armed) {
+        cue->play_when_armed = false;
+        set_playing(cue);
+    }
+}
+
+void CueEngine::loop_again(const std::shared_ptr<CueItem>& cue)
+{
+    // Fade points are in stream time, which starts over; keep the gain reached
+    if (cue->fader)
+        fade_set(cue->fader, fade_gain(cue->gst_pipeline, cue->fader));
+
+    // Not flushing: the next pass is queued right behind what is still playing
+    trace_instant("loop", cue->id);
+    if (!gst_element_seek(cue->gst_pipeline, 1.0, GST_FORMAT_TIME,
+                          static_cast<GstSeekFlags>(GST_SEEK_FLAG_SEGMENT | GST_SEEK_FLAG_ACCURATE),
+                          GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE))
+        std::cerr << "Cue " << cue->name << ": loop seek failed" << std::endl;
+}
+
+void CueEngine::arm_loop_crossfade(const std::shared_ptr<CueItem>& cue, GstClockTime crossfade)
+{
+    // The partner starts on the timer thread, on time; only GStreamer is
+    // touched there, through refs held for as long as the loop runs
+    auto state = std::make_unique<LoopCrossfade>();
+    state->pipelines[0].reset(GST_ELEMENT(gst_object_ref(cue->gst_pipeline)), gst_object_unref);
+    state->pipelines[1].reset(GST_ELEMENT(gst_object_ref(cue->loop_partner)), gst_object_unref);
+    state->faders[0] = cue->fader;
+    state->faders[1] = cue->partner_fader;
+    state->crossfade = crossfade;
+
+    std::weak_ptr<CueItem> weak_cue = cue;
+    state->swap = [this, weak_cue]() {
+        if (auto cue = weak_cue.lock())
+            swap_loop_pipelines(cue);
+    };
+    LoopCrossfade* loop = state.get();
+    state->on_time = [loop]() {
+        int in = loop->incoming.load(std::memory_order_acquire);
+        int out = 1 - in;
+        double gain = fade_gain(loop->pipelines[out].get(), loop->faders[out]);
+        fade_start(loop->pipelines[in].get(), loop->faders[in], gain, loop->crossfade, FadeCurve::EqualPower);
+        gst_element_set_state(loop->pipelines[in].get(), GST_STATE_PLAYING);
+        fade_start(loop->pipelines[out].get(), loop->faders[out], 0.0, loop->crossfade, FadeCurve::EqualPower);
+    };
+    cue->loop_crossfade = std::move(state);
+}
+
+void CueEngine::schedule_loop_crossfade(const std::shared_ptr<CueItem>& cue)
+{
+    LoopCrossfade* loop = cue->loop_crossfade.get();
+    if (!loop)
+        return;
+    gint64 position = 0;
+    if (!gst_element_query_position(cue->gst_pipeline, GST_FORMAT_TIME, &position) || position < 0)
+        position = 0;
+    gint64 remaining = static_cast<gint64>(cue->loop_duration - loop->crossfade) - position;
+    int delay_ms = static_cast<int>(std::max<gint64>(remaining, 0) / GST_MSECOND);
+
+    // By reference, so a pass allocates nothing; release() cancels the timer
+    // before the actions go
+    scheduler->schedule(delay_ms, std::ref(loop->swap), cue->id, CueScheduler::Wait::None, std::ref(loop->on_time));
+}
+
+void CueEngine::swap_loop_pipelines(const std::shared_ptr<CueItem>& cue)
+{
+    // The new pass is the cue's pipeline now; the old one fades out and is
+    // rewound for the next loop point when it ends
+    trace_instant("loop", cue->id);
+    std::swap(cue->gst_pipeline, cue->loop_partner);
+    std::swap(cue->fader, cue->partner_fader);
+    std::swap(cue->audio_input, cue->partner_input);
+    int in = cue->loop_crossfade->incoming.load(std::memory_order_relaxed);
+    cue->loop_crossfade->incoming.store(1 - in, std::memory_order_release);
+    cue->crossfading = true;
+    schedule_loop_crossfade(cue);
+}
+
+void CueEngine::on_partner_bus_event(std::shared_ptr<CueItem> cue, const BusDispatcher::Event& event)
+{
+    switch (event.type) {
+    case BusDispatcher::Event::Type::Eos:
+        // Rewound and silent until the next loop point
+        if (cue->loop_partner) {
+            gst_element_set_state(cue->loop_partner, GST_STATE_PAUSED);
+            gst_element_seek_simple(cue->loop_partner, GST_FORMAT_TIME,
+                                    static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE), 0);
+            fade_set(cue->partner_fader, 0.0);
+        }
+        cue->crossfading = false;
+        return;
+    case BusDispatcher::Event::Type::Error:
+        // The current pass plays out and the cue ends there
+        std::cerr << "Cue " << cue->name << " loop failed: " << event.text << std::endl;
+        scheduler->cancel_owner(cue->id);
+        release_partner(cue);
+        return;
+    default:
+        return;
+    }
+}
+
+void CueEngine::release_partner(const std::shared_ptr<CueItem>& cue)
+{
+    if (cue->loop_partner) {
+        bus_dispatcher.unwatch(cue->loop_partner);
+        gst_element_set_state(cue->loop_partner, GST_STATE_NULL);
+        gst_object_unref(cue->loop_partner);
+        cue->loop_partner = nullptr;
+    }
+    cue->partner_fader = nullptr;
+    if (cue->partner_input >= 0) {
+        audio_engine.release_input(cue->partner_input);
+        cue->partner_input = -1;
+    }
+    cue->loop_duration = 0;
+    cue->loop_crossfade.reset();
+    cue->crossfading = false;
+}
+
+CueScheduler::Action CueEngine::start_on_time(std::shared_ptr<CueItem> cue)
+{
+    // Runs on the scheduler thread, so it holds its own pipeline ref and
+    // touches nothing but GStreamer and the atomic GO time. The timer's main
+    // thread action keeps the cue alive until this has run or been cancelled.
+    std::shared_ptr<GstElement> pipeline(GST_ELEMENT(gst_object_ref(cue->gst_pipeline)), gst_object_unref);
+    CueItem* item = cue.get();
+    return [pipeline, item]() {
+        TraceSpan span("set_state PLAYING", item->id);
+        item->go_time_us = g_get_monotonic_time();
+        if (!item->go_from_standby)
+            trace_async_begin("preroll", item->id);
+        gst_element_set_state(pipeline.get(), GST_STATE_PLAYING);
+    };
+}
+
+GstPadProbeReturn CueEngine::on_sink_buffer_probe(GstPad* /*pad*/, GstPadProbeInfo* info, gpointer user_data)
+{
+    // Runs on the streaming thread. A pre-rolled sink already holds its first
+    // buffer, so for standby cues this is the first buffer pushed after GO.
+    auto* context = static_cast<PipelineContext*>(user_data);
+    CueItem* cue = context->cue;
+    cue->health.on_sink_buffer(GST_PAD_PROBE_INFO_BUFFER(info), cue->type == CueItem::Type::Audio, context->next_pts);
+
+    gint64 go_time = cue->go_time_us.exchange(0);
+    if (go_time != 0) {
+        gint64 now = g_get_monotonic_time();
+        cue->health.first_buffer_us.store(now, std::memory_order_relaxed);
+        trace_complete("GO to first buffer", cue->id, go_time, now);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void CueEngine::on_element_added(GstBin* /*bin*/, GstBin* /*sub_bin*/, GstElement* element, gpointer user_data)
+{
+    // Runs on whichever thread plugs the decoder
+    auto* context = static_cast<PipelineContext*>(user_data);
+    CueItem* cue = context->cue;
+    const gchar* klass = gst_element_get_metadata(element, GST_ELEMENT_METADATA_KLASS);
+    if (!klass || !strstr(klass, "Decoder"))
+        return;
+    if (!strstr(klass, cue->type == CueItem::Type::Video ? "Video" : "Audio"))
+        return;
+
+    GstPad* sink_pad = gst_element_get_static_pad(element, "sink");
+    GstPad* src_pad = gst_element_get_static_pad(element, "src");
+    if (sink_pad && src_pad) {
+        gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, &CueEngine::on_decoder_input_probe, context, nullptr);
+        gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, &CueEngine::on_decoder_output_probe, context, nullptr);
+    }
+    if (sink_pad)
+        gst_object_unref(sink_pad);
+    if (src_pad)
+        gst_object_unref(src_pad);
+}
+
+GstPadProbeReturn CueEngine::on_decoder_input_probe(GstPad* /*pad*/, GstPadProbeInfo* /*info*/, gpointer user_data)
+{
+    static_cast<PipelineContext*>(user_data)->cue.load()->health.on_decoder_input();
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn CueEngine::on_decoder_output_probe(GstPad* /*pad*/, GstPadProbeInfo* /*info*/, gpointer user_data)
+{
+    static_cast<PipelineContext*>(user_data)->cue.load()->health.on_decoder_output();
+    return GST_PAD_PROBE_OK;
+}
+
+void CueEngine::set_standby(std::shared_ptr<CueItem> cue)
+{
+    if (cue == standby_cue)
+        return;
+
+    release_standby();
+    if (!cue || (cue->type != CueItem::Type::Audio && cue->type != CueItem::Type::Video))
+        return;
+
+    // Already running (or already standing by): leave it alone
+    if (cue->gst_pipeline)
+        return;
+
+    if (listener.cue_standby)
+        listener.cue_standby(cue);
+
+    cue->health.reset();
+    cue->gst_pipeline = build_cue_pipeline(cue, cue->audio_input, cue->fader);
+    if (!cue->gst_pipeline)
+        return;
+
+    // PAUSED pre-rolls asynchronously on the streaming threads
+    trace_async_begin("preroll", cue->id);
+    {
+        TraceSpan span("set_state PAUSED", cue->id);
+        gst_element_set_state(cue->gst_pipeline, GST_STATE_PAUSED);
+    }
+    cue->standby = true;
+    standby_cue = cue;
+    trace_instant("standby", cue->id);
+}
+
+void CueEngine::release_standby()
+{
+    auto cue = standby_cue;
+    standby_cue.reset();
+
+    // GO may have selected the next row before starting this one
+    if (!cue || cue == active_cue || !cue->standby)
+        return;
+
+    release(cue);
+}
+
+void CueEngine::stop(std::shared_ptr<CueItem> cue)
+{
+    release(cue);
+    if (cue->type == CueItem::Type::Video)
+        show_fallback();
+}
+
+void CueEngine::stop_all()
+{
+    auto running = running_cues;
+    for (const auto& cue : running)
+        stop(cue);
+}
+
+void CueEngine::pause(std::shared_ptr<CueItem> cue, bool paused)
+{
+    // Pending prewait/postwait timers hold their remaining time
+    if (paused)
+        scheduler->pause_owner(cue->id);
+    else
+        scheduler->resume_owner(cue->id);
+
+    if (cue->type == CueItem::Type::Slideshow) {
+        if (output.pause_slideshow)
+            output.pause_slideshow(paused);
+    } else if (cue->loop_forever && !cue->loop_armed) {
+        // Still being armed; it starts from there unless paused
+        cue->play_when_armed = !paused && running_cues.count(cue);
+    } else if (cue->gst_pipeline && running_cues.count(cue)) {
+        gst_element_set_state(cue->gst_pipeline, paused ? GST_STATE_PAUSED : GST_STATE_PLAYING);
+        // Both passes are audible while crossfading
+        if (cue->crossfading && cue->loop_partner)
+            gst_element_set_state(cue->loop_partner, paused ? GST_STATE_PAUSED : GST_STATE_PLAYING);
+    }
+}
+
+void CueEngine::fade(std::shared_ptr<CueItem> cue, double target)
+{
+    if (!cue->gst_pipeline)
+        return;
+
+    GstClockTime duration = static_cast<GstClockTime>(cue->fade_ms) * GST_MSECOND;
+    if (cue->fader && fade_start(cue->gst_pipeline, cue->fader, target, duration, cue->fade_curve))
+        return;
+
+    // No fader (fallback audio sink): jump straight to the target
+    g_object_set(cue->gst_pipeline, "volume", target, nullptr);
+}
+
+void CueEngine::step_slide(std::shared_ptr<CueItem> cue, int step)
+{
+    int count = static_cast<int>(cue->slideshow_images.size());
+    if (count == 0)
+        return;
+    cue->slideshow_position = ((cue->slideshow_position + step) % count + count) % count;
+    if (output.show_slide)
+        output.show_slide(cue->slideshow_images[cue->slideshow_position]);
+    if (listener.slide_changed)
+        listener.slide_changed(cue);
+}
+
+void CueEngine::on_cue_finished()
+{
+    if (!active_cue || !active_cue->auto_next)
+        return;
+
+    if (auto next_cue = cue_list.next(active_cue->id))
+        go(next_cue);
+}
+
+void CueEngine::remove(std::shared_ptr<CueItem> cue)
+{
+    if (cue->type == CueItem::Type::Video || cue->type == CueItem::Type::Slideshow)
+        show_fallback();
+
+    release(cue);
+    if (active_cue == cue)
+        active_cue.reset();
+    if (standby_cue == cue)
+        standby_cue.reset();
+}
+
+void CueEngine::release_all()
+{
+    cue_list.for_each([this](const std::shared_ptr<CueItem>& cue) {
+        release(cue);
+    });
+}
+
+void CueEngine::clear()
+{
+    release_standby();
+    release_all();
+    active_cue.reset();
+    standby_cue.reset();
+    running_cues.clear();
+    cue_list.clear();
+    notify_state_changed();
+}
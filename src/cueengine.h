@@ -0,0 +1,181 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include "audioengine.h"
+#include "busdispatcher.h"
+#include "commandrunner.h"
+#include "cueitem.h"
+#include "cuelist.h"
+#include "cuescheduler.h"
+
+// The show itself, without any window: the cue list, which cue is active,
+// standing by and running, and every cue pipeline, command and timer. Runs
+// on the main loop (BusDispatcher, CommandRunner and CueScheduler all
+// deliver there), so it works under a Gtk::Application or a plain
+// Glib::MainLoop alike.
+//
+// Anything visible goes through two sets of callbacks. Output is the program
+// output (video layers, slides, the fallback image); unset, video renders
+// into a synced fakesink and the rest is a no-op. Listener is how views
+// learn about state changes; every callback is optional.
+//
+// A media cue with auto_next whose next cue is the same kind of media with no
+// prewait is gapless: the next file is queued on the running playbin as the
+// current one drains, and the pipeline is handed to the next cue when its
+// stream starts, so there is no EOS, rebuild or pre-roll in between.
+//
+// loop_forever cues loop on segment seeks: each pass is queued behind the
+// one still playing, so the loop point has no gap and nothing is rebuilt.
+// Audio loops with loop_crossfade_ms instead alternate between two
+// pipelines on the file, built once, crossfading at every loop point.
+//
+// A media cue's pipeline is released as soon as it ends, before its mixer
+// input and output layer are freed for other cues. A video cue with
+// last_frame leaves its final frame held by the output until the next
+// visual cue.
+class CueEngine
+{
+public:
+    struct Output {
+        std::function<GstElement*(int& layer)> create_video_sink;
+        std::function<void(int layer)> show_video_layer;
+        std::function<void(int layer)> release_video_layer;
+        // keeps the layer's last frame on screen and frees the layer; false if
+        // there was no frame to keep
+        std::function<bool(int layer)> hold_video_layer;
+        std::function<void()> show_fallback;
+        std::function<void(std::shared_ptr<CueItem>)> start_slideshow;
+        std::function<void(const std::string& path)> show_slide;
+        std::function<void(bool paused)> pause_slideshow;
+    };
+    struct Listener {
+        // running, active or standby changed
+        std::function<void()> state_changed;
+        std::function<void(std::shared_ptr<CueItem>)> cue_started;
+        std::function<void(std::shared_ptr<CueItem>)> cue_stopped;
+        std::function<void(std::shared_ptr<CueItem>, const std::string& error)> cue_failed;
+        // a standby pipeline is being pre-rolled for the cue
+        std::function<void(std::shared_ptr<CueItem>)> cue_standby;
+        // short status for the cue's row, e.g. a command's exit
+        std::function<void(std::shared_ptr<CueItem>, const std::string& text)> cue_status;
+        std::function<void(std::shared_ptr<CueItem>)> slide_changed;
+    };
+
+    // `audio_sink` is the device element factory, see AudioEngine
+    explicit CueEngine(std::shared_ptr<CueScheduler> scheduler, const std::string& audio_sink = "autoaudiosink");
+    ~CueEngine();
+
+    CueEngine(const CueEngine&) = delete;
+    CueEngine& operator=(const CueEngine&) = delete;
+
+    void set_output(Output output);
+    void set_listener(Listener listener);
+
+    // authoritative cue order
+    CueList& cues() { return cue_list; }
+    const CueList& cues() const { return cue_list; }
+    std::shared_ptr<CueScheduler> get_scheduler() const { return scheduler; }
+
+    std::shared_ptr<CueItem> get_active() const { return active_cue; }
+    std::shared_ptr<CueItem> get_standby() const { return standby_cue; }
+    const std::set<std::shared_ptr<CueItem>>& get_running() const { return running_cues; }
+    bool is_running(const std::shared_ptr<CueItem>& cue) const { return running_cues.count(cue) > 0; }
+    bool is_paused(const std::shared_ptr<CueItem>& cue) const;
+
+    // Makes the cue active and starts it, after its prewait
+    void go(std::shared_ptr<CueItem> cue);
+
+    // standby: the next cue is built and pre-rolled to PAUSED; nullptr releases it
+    void set_standby(std::shared_ptr<CueItem> cue);
+    void release_standby();
+
+    void stop(std::shared_ptr<CueItem> cue);
+    void stop_all();
+    void pause(std::shared_ptr<CueItem> cue, bool paused);
+    void fade(std::shared_ptr<CueItem> cue, double target);
+    // Shows the slide `step` away from the current one
+    void step_slide(std::shared_ptr<CueItem> cue, int step);
+    // finish_cue: the cue ends (and may auto-continue) when the command exits
+    void run_command(std::shared_ptr<CueItem> cue, bool finish_cue);
+
+    // Frees the cue's pipeline, command and timers
+    void release(std::shared_ptr<CueItem> cue);
+    // Releases the cue and forgets it as active/standby; the caller unlists it
+    void remove(std::shared_ptr<CueItem> cue);
+    void release_all();
+    // Releases everything and empties the cue list
+    void clear();
+    // Call after cues are added, moved, edited or removed, so running cues
+    // queue the right next cue for a gapless hand-off
+    void cues_changed();
+    // Call after the cue's own settings were edited: a standby pipeline
+    // pre-rolled with the old ones is built again, then as cues_changed()
+    void cue_edited(std::shared_ptr<CueItem> cue);
+
+private:
+    // Per pipeline, shared with its streaming threads and freed with the
+    // pipeline. The cue changes on a gapless hand-off.
+    struct PipelineContext {
+        std::atomic<CueItem*> cue{nullptr};
+        std::atomic<guint64> next_pts{GST_CLOCK_TIME_NONE}; // see CueHealth::on_sink_buffer
+        std::mutex mutex;     // guards the chain below
+        std::string next_uri; // set on about-to-finish; empty ends the cue normally
+        uint64_t next_id = 0;
+        uint64_t queued_id = 0; // cue whose media playbin is now streaming into
+    };
+
+    void start_slideshow_cue(std::shared_ptr<CueItem> cue);
+    void start_video_cue(std::shared_ptr<CueItem> cue);
+    void start_audio_cue(std::shared_ptr<CueItem> cue);
+    void start_command_cue(std::shared_ptr<CueItem> cue);
+    void on_command_done(std::shared_ptr<CueItem> cue, bool finish_cue, const CommandRunner::Result& result);
+    void on_cue_finished();
+
+    // The pipeline's mixer input and fader are stored in `audio_input` and `fader`
+    GstElement* build_cue_pipeline(std::shared_ptr<CueItem> cue, int& audio_input, GstElement*& fader);
+    BusDispatcher::Handler bus_handler(GstElement* pipeline, std::shared_ptr<CueItem> cue);
+    void set_playing(const std::shared_ptr<CueItem>& cue);
+    // loop_forever: on the first pre-roll, sets up the segment seek or the crossfade partner
+    void arm_loop(const std::shared_ptr<CueItem>& cue);
+    void loop_again(const std::shared_ptr<CueItem>& cue);
+    void arm_loop_crossfade(const std::shared_ptr<CueItem>& cue, GstClockTime crossfade);
+    void schedule_loop_crossfade(const std::shared_ptr<CueItem>& cue);
+    void swap_loop_pipelines(const std::shared_ptr<CueItem>& cue);
+    void on_partner_bus_event(std::shared_ptr<CueItem> cue, const BusDispatcher::Event& event);
+    void release_partner(const std::shared_ptr<CueItem>& cue);
+    static PipelineContext* context_of(GstElement* pipeline);
+    // Queues the next cue on `cue`'s pipeline if the two can play gaplessly
+    void arm_chain(const std::shared_ptr<CueItem>& cue);
+    static void on_about_to_finish(GstElement* playbin, gpointer user_data);
+    void hand_off(std::shared_ptr<CueItem> from, std::shared_ptr<CueItem> to);
+    // started: the scheduler already set it PLAYING at the prewait deadline
+    void play_cue_pipeline(std::shared_ptr<CueItem> cue, bool started = false);
+    CueScheduler::Action start_on_time(std::shared_ptr<CueItem> cue);
+    static GstPadProbeReturn on_sink_buffer_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static void on_element_added(GstBin* bin, GstBin* sub_bin, GstElement* element, gpointer user_data);
+    static GstPadProbeReturn on_decoder_input_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn on_decoder_output_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    void on_cue_bus_event(std::shared_ptr<CueItem> cue, GstElement* pipeline, const BusDispatcher::Event& event);
+
+    void show_fallback();
+    void notify_state_changed();
+
+    std::shared_ptr<CueScheduler> scheduler; // prewait/postwait timers are owned by the cue's id
+    std::string audio_sink;
+    AudioEngine audio_engine;
+    BusDispatcher bus_dispatcher;
+    CommandRunner command_runner;
+    Output output;
+    Listener listener;
+
+    CueList cue_list;
+    std::shared_ptr<CueItem> active_cue;
+    std::shared_ptr<CueItem> standby_cue;
+    std::set<std::shared_ptr<CueItem>> running_cues;
+};
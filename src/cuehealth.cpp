@@ -0,0 +1,94 @@
+#include "cuehealth.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Audio timestamps may wobble by a sample or two between buffers
+constexpr GstClockTime gap_tolerance = 10 * GST_MSECOND;
+
+}
+
+void CueHealth::reset()
+{
+    buffers = 0;
+    gaps = 0;
+    decode_in_us = 0;
+    decode_total_us = 0;
+    decode_count = 0;
+    decode_max_us = 0;
+    first_buffer_us = 0;
+    frames_processed = 0;
+    frames_dropped = 0;
+    audio_qos = 0;
+    lateness_total_us = 0;
+    lateness_count = 0;
+    buffering_percent = 100;
+}
+
+void CueHealth::on_sink_buffer(GstBuffer* buffer, bool audio, std::atomic<guint64>& next_pts)
+{
+    buffers.fetch_add(1, std::memory_order_relaxed);
+    if (!audio || !buffer)
+        return;
+
+    // A hole in the audio timeline is an underrun the audience hears. Time
+    // going back is a loop or a new file, not a hole.
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    GstClockTime expected = next_pts.load(std::memory_order_relaxed);
+    bool backwards = GST_CLOCK_TIME_IS_VALID(pts) && expected != GST_CLOCK_TIME_NONE && pts + gap_tolerance < expected;
+    bool discont = GST_BUFFER_IS_DISCONT(buffer) && expected != GST_CLOCK_TIME_NONE;
+    bool gap = GST_CLOCK_TIME_IS_VALID(pts) && expected != GST_CLOCK_TIME_NONE && pts > expected + gap_tolerance;
+    if (!backwards && (discont || gap))
+        gaps.fetch_add(1, std::memory_order_relaxed);
+
+    if (GST_CLOCK_TIME_IS_VALID(pts) && GST_BUFFER_DURATION_IS_VALID(buffer))
+        next_pts.store(pts + GST_BUFFER_DURATION(buffer), std::memory_order_relaxed);
+}
+
+void CueHealth::on_decoder_input()
+{
+    // Decoders that hold frames back are measured from their oldest input
+    gint64 none = 0;
+    decode_in_us.compare_exchange_strong(none, g_get_monotonic_time(), std::memory_order_relaxed);
+}
+
+void CueHealth::on_decoder_output()
+{
+    gint64 in_us = decode_in_us.exchange(0, std::memory_order_relaxed);
+    if (in_us == 0)
+        return;
+
+    gint64 sample = g_get_monotonic_time() - in_us;
+    decode_total_us.fetch_add(sample, std::memory_order_relaxed);
+    decode_count.fetch_add(1, std::memory_order_relaxed);
+    gint64 max = decode_max_us.load(std::memory_order_relaxed);
+    while (sample > max && !decode_max_us.compare_exchange_weak(max, sample, std::memory_order_relaxed)) {
+    }
+}
+
+std::string CueHealth::describe(bool video) const
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+
+    if (video) {
+        guint64 arrived = std::max<guint64>(buffers.load(std::memory_order_relaxed), frames_processed);
+        text << (arrived - std::min(arrived, frames_dropped)) << " frames, " << frames_dropped << " dropped";
+        if (lateness_count > 0)
+            text << ", late " << lateness_total_us / 1000.0 / lateness_count << " ms";
+    } else {
+        guint64 count = underruns();
+        text << count << (count == 1 ? " underrun" : " underruns");
+    }
+
+    guint64 decoded = decode_count.load(std::memory_order_relaxed);
+    if (decoded > 0) {
+        text << ", decode " << decode_total_us.load(std::memory_order_relaxed) / 1000.0 / decoded << " ms"
+             << " (max " << decode_max_us.load(std::memory_order_relaxed) / 1000.0 << ")";
+    }
+    if (buffering_percent < 100)
+        text << ", buffering " << buffering_percent << "%";
+    return text.str();
+}
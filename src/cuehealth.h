@@ -0,0 +1,45 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <string>
+
+// Playback health of a cue's current run, for spotting media that is too
+// heavy before the audience does.
+//
+// The buffer and decode counters are written on the cue's streaming threads
+// by pad probes, with relaxed atomics. The QoS and buffering fields are
+// folded per pipeline by BusDispatcher off the main thread and stored here
+// on the main thread. Reading is a handful of loads, so the playlist can
+// poll it for every running cue.
+struct CueHealth {
+    // streaming threads
+    std::atomic<guint64> buffers{0};        // buffers that reached the cue's sink
+    std::atomic<guint64> gaps{0};           // audio: discontinuities and timestamp gaps
+    std::atomic<gint64> decode_in_us{0};    // oldest input still inside the decoder
+    std::atomic<gint64> decode_total_us{0};
+    std::atomic<guint64> decode_count{0};
+    std::atomic<gint64> decode_max_us{0};
+    std::atomic<gint64> first_buffer_us{0}; // when GO's first buffer reached the sink, 0 until then
+
+    // main thread, from QoS and buffering messages
+    guint64 frames_processed = 0; // video frames the sink handled, rendered or dropped
+    guint64 frames_dropped = 0;
+    guint64 audio_qos = 0;        // QoS from audio sinks: late or dropped samples
+    gint64 lateness_total_us = 0;
+    guint64 lateness_count = 0;
+    int buffering_percent = 100;
+
+    // Main thread, before the pipeline streams
+    void reset();
+
+    // Streaming threads. `next_pts` is where the pipeline's audio is expected
+    // to continue; one per pipeline, since a cue may have two at a loop point.
+    void on_sink_buffer(GstBuffer* buffer, bool audio, std::atomic<guint64>& next_pts);
+    void on_decoder_input();
+    void on_decoder_output();
+
+    guint64 underruns() const { return gaps.load(std::memory_order_relaxed) + audio_qos; }
+    // One line for the cue panel, e.g. "1500 frames, 2 dropped, late 3.1 ms, decode 4.0 ms (max 9.2)"
+    std::string describe(bool video) const;
+};
@@ -1,8 +1,27 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
 #include <glibmm/refptr.h>
 #include <gst/gst.h>
+#include "transition.h"
+#include "fade.h"
+#include "cuehealth.h"
+
+// A crossfaded loop's loop point, built once when the loop is armed and
+// scheduled by reference at every pass. The timer thread touches only the
+// refs held here; `incoming` is the pipeline that fades in next.
+struct LoopCrossfade {
+    std::shared_ptr<GstElement> pipelines[2];
+    GstElement* faders[2] = {nullptr, nullptr};
+    GstClockTime crossfade = 0;
+    std::atomic<int> incoming{1};
+    std::function<void()> swap;     // main thread, after the loop point
+    std::function<void()> on_time;  // timer thread, at the loop point
+};
 
 // forward
 class CueItem {
@@ -41,19 +60,60 @@ public:
     }
 
     Type type;
+    // stable identity, assigned by CueList; 0 until the cue is listed
+    uint64_t id = 0;
     std::string name;
     std::string path_or_command;
     int prewait;         // seconds
     int postwait;        // seconds
     int action_duration; // seconds
+    bool duration_probed = false; // action_duration came from the media
     bool auto_next;
     bool immediate_next;
     bool loop_forever;
+    // audio loops: crossfade into the next pass over this, 0 cuts seamlessly
+    int loop_crossfade_ms = 0;
     bool last_frame;
 	std::vector<std::string> slideshow_images;
     double progress; // 0.0 to 1.0
     bool is_active;
-	int slideshow_interval_seconds;
+	int slideshow_interval_seconds = 0;
+    int slideshow_position = 0; // slide shown by the prev/next buttons
+    TransitionType slideshow_transition = TransitionType::Cut;
+    int slideshow_transition_ms = 0;
+    // fade buttons: down goes to fade_target, up to full, over fade_ms
+    int fade_ms = 3000;
+    double fade_target = 0.0;
+    FadeCurve fade_curve = FadeCurve::EqualPower;
+    // control cues: the command is terminated after this, 0 means no limit
+    int command_timeout = 0; // seconds
+    // CommandRunner job while the command runs, 0 otherwise
+    uint64_t command_job = 0;
     // future: you could add a GstElement* here
     GstElement* gst_pipeline = nullptr;
+    // true while gst_pipeline is a pre-rolled (PAUSED) standby pipeline
+    bool standby = false;
+    // set when GO flips the pipeline to PLAYING, consumed by the first buffer probe
+    std::atomic<gint64> go_time_us{0};
+    bool go_from_standby = false;
+    // program output layer the video cue renders into, -1 when none
+    int output_layer = -1;
+    // audio engine input the cue mixes into, -1 when none
+    int audio_input = -1;
+    // GstVolume in the cue's audio sink bin, owned by gst_pipeline
+    GstElement* fader = nullptr;
+    // playback stats of the current pipeline, reset when the cue starts or stands by
+    CueHealth health;
+    // loop_forever: the segment seek (or crossfade partner) is set up on the
+    // pre-rolled pipeline before it plays; GO meanwhile sets play_when_armed
+    bool loop_armed = false;
+    bool play_when_armed = false;
+    // crossfaded loops: a second pipeline on the same file, pre-rolled at
+    // its start, swaps roles with gst_pipeline at every loop point
+    GstElement* loop_partner = nullptr;
+    GstElement* partner_fader = nullptr;
+    int partner_input = -1;
+    GstClockTime loop_duration = 0;
+    std::unique_ptr<LoopCrossfade> loop_crossfade;
+    bool crossfading = false; // the old pass is still fading out on loop_partner
 };
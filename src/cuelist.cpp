@@ -0,0 +1,209 @@
+#include "cuelist.h"
+#include <algorithm>
+
+CueList::CueList()
+: rng(std::random_device{}())
+{
+}
+
+CueList::~CueList() = default;
+
+void CueList::update(Node* node)
+{
+    node->size = 1 + size_of(node->left) + size_of(node->right);
+    if (node->left)
+        node->left->parent = node;
+    if (node->right)
+        node->right->parent = node;
+}
+
+void CueList::split(Node* node, size_t count, Node*& left, Node*& right)
+{
+    // First `count` nodes go to `left`
+    if (!node) {
+        left = right = nullptr;
+        return;
+    }
+    if (size_of(node->left) < count) {
+        split(node->right, count - size_of(node->left) - 1, node->right, right);
+        left = node;
+    } else {
+        split(node->left, count, left, node->left);
+        right = node;
+    }
+    update(node);
+}
+
+CueList::Node* CueList::merge(Node* left, Node* right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+void CueList::attach(Node* node, size_t position)
+{
+    Node* left;
+    Node* right;
+    split(root, std::min(position, size_of(root)), left, right);
+    root = merge(merge(left, node), right);
+    root->parent = nullptr;
+}
+
+void CueList::detach(Node* node)
+{
+    Node* left;
+    Node* mid;
+    Node* right;
+    split(root, static_cast<size_t>(index_of(node->cue->id)), left, mid);
+    split(mid, 1, mid, right);
+    root = merge(left, right);
+    if (root)
+        root->parent = nullptr;
+
+    node->left = node->right = node->parent = nullptr;
+    node->size = 1;
+}
+
+uint64_t CueList::insert(size_t position, std::shared_ptr<CueItem> cue)
+{
+    auto node = std::make_unique<Node>();
+    node->cue = std::move(cue);
+    node->priority = rng();
+    node->cue->id = next_id++;
+
+    uint64_t id = node->cue->id;
+    attach(node.get(), position);
+    nodes[id] = std::move(node);
+    return id;
+}
+
+bool CueList::remove(uint64_t id)
+{
+    auto it = nodes.find(id);
+    if (it == nodes.end())
+        return false;
+
+    detach(it->second.get());
+    nodes.erase(it);
+    return true;
+}
+
+bool CueList::move(uint64_t id, size_t position)
+{
+    auto it = nodes.find(id);
+    if (it == nodes.end())
+        return false;
+
+    detach(it->second.get());
+    attach(it->second.get(), position);
+    return true;
+}
+
+void CueList::reorder(const int* new_order)
+{
+    std::vector<Node*> ordered;
+    ordered.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        auto cue = at(static_cast<size_t>(new_order[i]));
+        ordered.push_back(nodes[cue->id].get());
+    }
+
+    root = nullptr;
+    for (Node* node : ordered) {
+        node->left = node->right = node->parent = nullptr;
+        node->size = 1;
+        root = merge(root, node);
+    }
+    if (root)
+        root->parent = nullptr;
+}
+
+void CueList::clear()
+{
+    root = nullptr;
+    nodes.clear();
+}
+
+std::shared_ptr<CueItem> CueList::find(uint64_t id) const
+{
+    auto it = nodes.find(id);
+    return it == nodes.end() ? nullptr : it->second->cue;
+}
+
+std::shared_ptr<CueItem> CueList::at(size_t position) const
+{
+    Node* node = root;
+    while (node) {
+        size_t left = size_of(node->left);
+        if (position < left) {
+            node = node->left;
+        } else if (position == left) {
+            return node->cue;
+        } else {
+            position -= left + 1;
+            node = node->right;
+        }
+    }
+    return nullptr;
+}
+
+int CueList::index_of(uint64_t id) const
+{
+    auto it = nodes.find(id);
+    if (it == nodes.end())
+        return -1;
+
+    // Count everything to the left on the way up to the root
+    const Node* node = it->second.get();
+    size_t index = size_of(node->left);
+    for (; node->parent; node = node->parent) {
+        if (node == node->parent->right)
+            index += size_of(node->parent->left) + 1;
+    }
+    return static_cast<int>(index);
+}
+
+std::shared_ptr<CueItem> CueList::next(uint64_t id) const
+{
+    auto it = nodes.find(id);
+    if (it == nodes.end())
+        return nullptr;
+
+    const Node* node = it->second.get();
+    if (node->right) {
+        node = node->right;
+        while (node->left)
+            node = node->left;
+        return node->cue;
+    }
+    while (node->parent && node == node->parent->right)
+        node = node->parent;
+    return node->parent ? node->parent->cue : nullptr;
+}
+
+void CueList::for_each(const std::function<void(const std::shared_ptr<CueItem>&)>& fn) const
+{
+    // In order, without recursion
+    std::vector<const Node*> stack;
+    const Node* node = root;
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        fn(node->cue);
+        node = node->right;
+    }
+}
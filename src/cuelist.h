@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "cueitem.h"
+
+// The authoritative, ordered list of cues.
+//
+// Cues get a stable id on insertion and are found by id through a hash map.
+// Order is kept in an implicit treap (a randomized balanced tree keyed by
+// position, with subtree sizes and parent links), so position lookups, the
+// position of a given cue, inserts, removes, moves and "next cue" are all
+// O(log n) expected, and nothing is copied or shifted when the order changes.
+class CueList
+{
+public:
+    CueList();
+    ~CueList();
+
+    CueList(const CueList&) = delete;
+    CueList& operator=(const CueList&) = delete;
+
+    size_t size() const { return nodes.size(); }
+    bool empty() const { return nodes.empty(); }
+
+    // Inserts at `position` (clamped to size()) and assigns cue->id
+    uint64_t insert(size_t position, std::shared_ptr<CueItem> cue);
+    uint64_t push_back(std::shared_ptr<CueItem> cue) { return insert(size(), std::move(cue)); }
+    bool remove(uint64_t id);
+    // Moves the cue so that it ends up at `position` (clamped)
+    bool move(uint64_t id, size_t position);
+    // new_order[new_position] = old_position, as in GtkTreeModel::rows-reordered
+    void reorder(const int* new_order);
+    void clear();
+
+    std::shared_ptr<CueItem> find(uint64_t id) const;
+    std::shared_ptr<CueItem> at(size_t position) const;
+    int index_of(uint64_t id) const; // -1 when not listed
+    std::shared_ptr<CueItem> next(uint64_t id) const;
+
+    void for_each(const std::function<void(const std::shared_ptr<CueItem>&)>& fn) const;
+
+private:
+    struct Node {
+        std::shared_ptr<CueItem> cue;
+        uint32_t priority = 0;
+        size_t size = 1;
+        Node* left = nullptr;
+        Node* right = nullptr;
+        Node* parent = nullptr;
+    };
+
+    static size_t size_of(const Node* node) { return node ? node->size : 0; }
+    static void update(Node* node);
+    static void split(Node* node, size_t count, Node*& left, Node*& right);
+    static Node* merge(Node* left, Node* right);
+    void detach(Node* node);
+    void attach(Node* node, size_t position);
+
+    Node* root = nullptr;
+    std::unordered_map<uint64_t, std::unique_ptr<Node>> nodes;
+    uint64_t next_id = 1;
+    std::mt19937 rng;
+};
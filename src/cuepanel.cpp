@@ -0,0 +1,129 @@
+#include "cuepanel.h"
+
+CuePanel::CuePanel(IconCache& icons, const Actions& actions)
+: icons(icons),
+  actions(actions)
+{
+    make_button(button_playpause, image_playpause, "pause");
+    make_button(button_stop, image_stop, "stop");
+    make_button(button_remove, image_remove, "close");
+    make_button(button_vol_down, image_vol_down, "fade_down");
+    make_button(button_vol_up, image_vol_up, "fade_up");
+    make_button(button_prev, image_prev, "prev");
+    make_button(button_next, image_next, "fwd");
+    make_button(button_play, image_play, "play");
+
+    // Handlers look up the bound cue when clicked, so they are connected once
+    playpause_connection = button_playpause.signal_toggled().connect([this]() {
+        bool paused = button_playpause.get_active();
+        set_paused(paused);
+        if (this->cue)
+            this->actions.pause(this->cue, paused);
+    });
+    button_stop.signal_clicked().connect([this]() {
+        if (cue) this->actions.stop(cue);
+    });
+    button_remove.signal_clicked().connect([this]() {
+        // The action may unbind this panel; keep the cue alive meanwhile
+        if (auto bound = cue) this->actions.remove(bound);
+    });
+    button_vol_down.signal_clicked().connect([this]() {
+        if (cue) this->actions.fade(cue, false);
+    });
+    button_vol_up.signal_clicked().connect([this]() {
+        if (cue) this->actions.fade(cue, true);
+    });
+    button_prev.signal_clicked().connect([this]() {
+        if (cue) this->actions.slide(cue, -1);
+    });
+    button_next.signal_clicked().connect([this]() {
+        if (cue) this->actions.slide(cue, 1);
+    });
+    button_play.signal_clicked().connect([this]() {
+        if (cue) this->actions.run(cue);
+    });
+}
+
+void CuePanel::make_button(Gtk::Button& button, Gtk::Image& image, const std::string& icon)
+{
+    image.set(icons.get(icon));
+    button.set_image(image);
+}
+
+void CuePanel::set_paused(bool paused)
+{
+    image_playpause.set(icons.get(paused ? "play" : "pause"));
+}
+
+void CuePanel::bind(std::shared_ptr<CueItem> new_cue, bool paused)
+{
+    cue = new_cue;
+    for (auto* child : get_children())
+        remove(*child);
+
+    playpause_connection.block();
+    button_playpause.set_active(paused);
+    playpause_connection.unblock();
+    set_paused(paused);
+
+    switch (cue->type) {
+    case CueItem::Type::Audio:
+    case CueItem::Type::Video:
+        label.set_text((cue->type == CueItem::Type::Audio ? "Audio Cue: " : "Video Cue: ") + cue->name);
+        attach(label,             0, 0, 3, 1);
+        attach(button_playpause,  0, 1, 1, 1);
+        attach(button_stop,       1, 1, 1, 1);
+        attach(button_remove,     2, 1, 1, 1);
+        attach(button_vol_down,   1, 2, 1, 1);
+        attach(button_vol_up,     2, 2, 1, 1);
+        // Health of the running cue; filled in while it plays
+        detail.set_text("");
+        attach(detail,            0, 3, 3, 1);
+        break;
+    case CueItem::Type::Slideshow:
+        label.set_text("Slideshow: " + cue->name);
+        update_slide();
+        attach(label,             0, 0, 4, 1);
+        attach(detail,            0, 1, 4, 1);
+        attach(button_prev,       0, 2, 1, 1);
+        attach(button_playpause,  1, 2, 1, 1);
+        attach(button_next,       2, 2, 1, 1);
+        attach(button_remove,     3, 2, 1, 1);
+        break;
+    case CueItem::Type::Control:
+        label.set_text("Command: " + cue->name);
+        detail.set_text(cue->path_or_command);
+        attach(label,             0, 0, 4, 1);
+        attach(detail,            0, 1, 4, 1);
+        attach(button_play,       0, 2, 1, 1);
+        attach(button_remove,     1, 2, 1, 1);
+        break;
+    }
+    show_all();
+}
+
+void CuePanel::unbind()
+{
+    cue.reset();
+}
+
+void CuePanel::update_slide()
+{
+    if (!cue || cue->type != CueItem::Type::Slideshow)
+        return;
+
+    if (cue->slideshow_images.empty())
+        detail.set_text("(No slides)");
+    else
+        detail.set_text(cue->slideshow_images[cue->slideshow_position]);
+}
+
+void CuePanel::update_health(const std::string& text)
+{
+    if (!cue || (cue->type != CueItem::Type::Audio && cue->type != CueItem::Type::Video))
+        return;
+
+    // Polled every second; skip the relayout when nothing changed
+    if (detail.get_text() != text)
+        detail.set_text(text);
+}
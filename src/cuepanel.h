@@ -0,0 +1,64 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <functional>
+#include <memory>
+#include "cueitem.h"
+#include "iconcache.h"
+
+// The control panel shown on the right for one cue. Panels are not tied to
+// a cue for life: every widget is built once, and bind() re-lays the grid
+// for a cue's type and points the buttons at it. The playlist keeps panels
+// only for the selected and running cues and recycles the rest.
+class CuePanel : public Gtk::Grid
+{
+public:
+    // Button actions, all on the bound cue
+    struct Actions {
+        std::function<void(std::shared_ptr<CueItem>, bool paused)> pause;
+        std::function<void(std::shared_ptr<CueItem>)> stop;
+        std::function<void(std::shared_ptr<CueItem>)> remove;
+        std::function<void(std::shared_ptr<CueItem>, bool up)> fade;
+        std::function<void(std::shared_ptr<CueItem>, int step)> slide;
+        std::function<void(std::shared_ptr<CueItem>)> run;
+    };
+
+    CuePanel(IconCache& icons, const Actions& actions);
+
+    void bind(std::shared_ptr<CueItem> cue, bool paused);
+    void unbind();
+    std::shared_ptr<CueItem> get_cue() const { return cue; }
+
+    // Refreshes the slide label after the position changed
+    void update_slide();
+    // Shows playback health under an audio or video cue; empty hides it
+    void update_health(const std::string& text);
+
+private:
+    void make_button(Gtk::Button& button, Gtk::Image& image, const std::string& icon);
+    void set_paused(bool paused);
+
+    IconCache& icons;
+    Actions actions;
+    std::shared_ptr<CueItem> cue;
+
+    Gtk::Label label;
+    Gtk::Label detail;
+    Gtk::ToggleButton button_playpause;
+    Gtk::Button button_stop;
+    Gtk::Button button_remove;
+    Gtk::Button button_vol_down;
+    Gtk::Button button_vol_up;
+    Gtk::Button button_prev;
+    Gtk::Button button_next;
+    Gtk::Button button_play;
+    Gtk::Image image_playpause;
+    Gtk::Image image_stop;
+    Gtk::Image image_remove;
+    Gtk::Image image_vol_down;
+    Gtk::Image image_vol_up;
+    Gtk::Image image_prev;
+    Gtk::Image image_next;
+    Gtk::Image image_play;
+    sigc::connection playpause_connection;
+};
@@ -1,4 +1,5 @@
 #include "cuepropertiesdialog.h"
+#include <algorithm>
 
 CuePropertiesDialog::CuePropertiesDialog(Gtk::Window& parent, CueType type)
     : Gtk::Dialog("Cue Properties", parent, true),
@@ -47,6 +48,37 @@ CuePropertiesDialog::CuePropertiesDialog(Gtk::Window& parent, CueType type)
         last_frame.set_label("Keep showing last Frame");
         grid->attach(last_frame, 0, 4, 2, 1);
     }
+    if (cue_type == CueType::Audio) {
+        spin_loop_crossfade_ms.set_range(0, 10000);
+        spin_loop_crossfade_ms.set_increments(50, 500);
+        spin_loop_crossfade_ms.set_value(0);
+        spin_loop_crossfade_ms.set_tooltip_text("Crossfade at the loop point (milliseconds), 0 for a seamless cut");
+        grid->attach(*Gtk::make_managed<Gtk::Label>("Loop crossfade (ms):"), 2, 3, 1, 1);
+        grid->attach(spin_loop_crossfade_ms, 3, 3, 1, 1);
+    }
+    if (cue_type == CueType::Audio || cue_type == CueType::Video) {
+        spin_fade_ms.set_range(0, 60000);
+        spin_fade_ms.set_increments(100, 1000);
+        spin_fade_ms.set_value(3000);
+        spin_fade_target.set_range(0, 100);
+        spin_fade_target.set_increments(5, 10);
+        spin_fade_target.set_value(0);
+        for (auto curve : {FadeCurve::Linear, FadeCurve::EqualPower, FadeCurve::SCurve})
+            combo_fade_curve.append(fade_curve_name(curve));
+        combo_fade_curve.set_active(static_cast<int>(FadeCurve::EqualPower));
+
+        grid->attach(*Gtk::make_managed<Gtk::Label>("Fade (ms / down to %):"), 0, 5, 1, 1);
+        grid->attach(spin_fade_ms, 1, 5, 1, 1);
+        grid->attach(spin_fade_target, 2, 5, 1, 1);
+        grid->attach(combo_fade_curve, 3, 5, 1, 1);
+    }
+    if (cue_type == CueType::Control) {
+        spin_command_timeout.set_range(0, 86400);
+        spin_command_timeout.set_increments(1, 10);
+        spin_command_timeout.set_value(0);
+        grid->attach(*Gtk::make_managed<Gtk::Label>("Timeout (s, 0 = none):"), 0, 4, 1, 1);
+        grid->attach(spin_command_timeout, 1, 4, 1, 1);
+    }
     content_area->pack_start(*grid, Gtk::PACK_SHRINK);
 
     // cue-type-specific
@@ -118,6 +150,21 @@ CuePropertiesDialog::CuePropertiesDialog(Gtk::Window& parent, CueType type)
         auto interval_box = Gtk::make_managed<Gtk::Box>(Gtk::ORIENTATION_HORIZONTAL, 5);
         interval_box->pack_start(*interval_label, Gtk::PACK_SHRINK);
         interval_box->pack_start(spin_slideshow_interval, Gtk::PACK_SHRINK);
+
+        // transition between slides
+        for (auto type : {TransitionType::Cut, TransitionType::Crossfade,
+                          TransitionType::DipToBlack, TransitionType::Wipe})
+            combo_transition.append(transition_type_name(type));
+        combo_transition.set_active(0);
+
+        spin_transition_ms.set_range(0, 10000);
+        spin_transition_ms.set_increments(50, 250);
+        spin_transition_ms.set_value(500);
+        spin_transition_ms.set_tooltip_text("Transition duration (milliseconds)");
+
+        interval_box->pack_start(*Gtk::make_managed<Gtk::Label>("Transition:"), Gtk::PACK_SHRINK);
+        interval_box->pack_start(combo_transition, Gtk::PACK_SHRINK);
+        interval_box->pack_start(spin_transition_ms, Gtk::PACK_SHRINK);
     
         // layout
         slideshow_box.pack_start(slideshow_scrolled);
@@ -145,10 +192,23 @@ bool CuePropertiesDialog::run_and_get_result(CuePropertiesDialog::Result& result
                                 + spin_postwait_s.get_value_as_int();
         result.immediate = check_immediate.get_active();
         result.auto_next = check_auto_next.get_active();
+        result.loop_forever = check_loop_forever.get_active();
+        if (cue_type == CueType::Audio)
+            result.loop_crossfade_ms = spin_loop_crossfade_ms.get_value_as_int();
+        if (cue_type == CueType::Video)
+            result.last_frame = last_frame.get_active();
         result.slideshow_interval_seconds = spin_slideshow_interval.get_value_as_int();
+        if (cue_type == CueType::Audio || cue_type == CueType::Video) {
+            result.fade_ms = spin_fade_ms.get_value_as_int();
+            result.fade_target = spin_fade_target.get_value() / 100.0;
+            result.fade_curve = static_cast<FadeCurve>(std::max(0, combo_fade_curve.get_active_row_number()));
+        }
         if (cue_type == CueType::Control) {
             result.file_or_command = command_entry.get_text();
+            result.command_timeout = spin_command_timeout.get_value_as_int();
         } else if (cue_type == CueType::Slideshow) {
+            result.transition = static_cast<TransitionType>(std::max(0, combo_transition.get_active_row_number()));
+            result.transition_ms = spin_transition_ms.get_value_as_int();
             result.slideshow_files.clear();
             for (auto& row : slideshow_store->children()) {
                 Glib::ustring value = row[slideshow_columns.filepath];
@@ -3,6 +3,8 @@
 #include <gtkmm.h>
 #include <vector>
 #include <string>
+#include "transition.h"
+#include "fade.h"
 
 class CuePropertiesDialog : public Gtk::Dialog
 {
@@ -24,8 +26,15 @@ public:
         bool immediate;
         bool auto_next;
         bool loop_forever;
-        bool last_frame;
+        bool last_frame = false;
         int slideshow_interval_seconds = 0;  // default
+        TransitionType transition = TransitionType::Cut;
+        int transition_ms = 0;
+        int fade_ms = 3000;
+        double fade_target = 0.0;
+        FadeCurve fade_curve = FadeCurve::EqualPower;
+        int command_timeout = 0;
+        int loop_crossfade_ms = 0;
     };
 
     CuePropertiesDialog(Gtk::Window& parent, CueType type);
@@ -45,10 +54,16 @@ public:
 
     // Audio/Video:
     Gtk::FileChooserButton file_chooser;
+    Gtk::SpinButton spin_fade_ms;
+    Gtk::SpinButton spin_fade_target;
+    Gtk::ComboBoxText combo_fade_curve;
+    // Audio
+    Gtk::SpinButton spin_loop_crossfade_ms;
     //Video
     Gtk::CheckButton last_frame;
     // Control:
     Gtk::Entry command_entry;
+    Gtk::SpinButton spin_command_timeout;
 
     // Slideshow:
     Gtk::Box slideshow_box {Gtk::ORIENTATION_HORIZONTAL};
@@ -59,6 +74,8 @@ public:
     Gtk::Button button_add_images {"Add Images"};
     Gtk::Button button_remove_image {"Remove Selected"};
     Gtk::SpinButton spin_slideshow_interval;
+    Gtk::ComboBoxText combo_transition;
+    Gtk::SpinButton spin_transition_ms;
 
     bool run_and_get_result(Result& result);
 
@@ -0,0 +1,383 @@
+#include "cuescheduler.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sys/prctl.h>
+
+namespace {
+
+constexpr gint64 second_us = 1000000;
+// Deliveries later than this are logged
+constexpr gint64 late_warning_us = 5000;
+
+int seconds_left(gint64 remaining_us)
+{
+    return static_cast<int>((std::max<gint64>(remaining_us, 0) + second_us - 1) / second_us);
+}
+
+}
+
+CueScheduler::CueScheduler()
+: slots(slot_count)
+{
+    thread = std::thread(&CueScheduler::thread_main, this);
+}
+
+CueScheduler::~CueScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (delivery_source) {
+        g_source_destroy(delivery_source);
+        g_source_unref(delivery_source);
+        delivery_source = nullptr;
+    }
+}
+
+gint64 CueScheduler::now_us()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t CueScheduler::schedule(int delay_ms, Action action, uint64_t owner, Wait wait, Action on_time)
+{
+    gint64 now = now_us();
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = next_id++;
+    Timer& timer = timers[id];
+    timer.id = id;
+    timer.owner = owner;
+    timer.wait = wait;
+    timer.deadline_us = now + std::max(delay_ms, 0) * tick_us;
+    timer.action = std::move(action);
+    timer.on_time = std::move(on_time);
+    arm_countdown(timer, now);
+    insert_locked(timer);
+    if (wait != Wait::None) {
+        push_countdown_locked(timer, now, false);
+        post_locked();
+    }
+    return id;
+}
+
+uint64_t CueScheduler::schedule_every(int period_ms, Action action, uint64_t owner)
+{
+    gint64 now = now_us();
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = next_id++;
+    Timer& timer = timers[id];
+    timer.id = id;
+    timer.owner = owner;
+    timer.period_us = std::max(period_ms, 1) * tick_us;
+    timer.deadline_us = now + timer.period_us;
+    timer.action = std::move(action);
+    insert_locked(timer);
+    return id;
+}
+
+void CueScheduler::cancel(uint64_t id)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = timers.find(id);
+        if (it == timers.end())
+            return;
+        // Stale wheel entries are skipped when their slot comes round
+        if (it->second.wait != Wait::None && !it->second.fired) {
+            push_countdown_locked(it->second, now_us(), true);
+            post_locked();
+        }
+        timers.erase(it);
+    }
+    // Wait out an on_time action that is already running
+    std::lock_guard<std::mutex> running(on_time_mutex);
+}
+
+void CueScheduler::cancel_owner(uint64_t owner)
+{
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ids = owned_locked(owner);
+    }
+    for (uint64_t id : ids)
+        cancel(id);
+}
+
+void CueScheduler::pause(uint64_t id)
+{
+    gint64 now = now_us();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = timers.find(id);
+    if (it == timers.end() || it->second.paused || it->second.fired)
+        return;
+
+    Timer& timer = it->second;
+    timer.paused = true;
+    timer.remaining_us = std::max<gint64>(timer.deadline_us - now, 0);
+    if (timer.wait != Wait::None) {
+        push_countdown_locked(timer, now, false);
+        post_locked();
+    }
+}
+
+void CueScheduler::resume(uint64_t id)
+{
+    gint64 now = now_us();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = timers.find(id);
+    if (it == timers.end() || !it->second.paused)
+        return;
+
+    Timer& timer = it->second;
+    timer.paused = false;
+    timer.deadline_us = now + timer.remaining_us;
+    arm_countdown(timer, now);
+    insert_locked(timer);
+    if (timer.wait != Wait::None) {
+        push_countdown_locked(timer, now, false);
+        post_locked();
+    }
+}
+
+void CueScheduler::pause_owner(uint64_t owner)
+{
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ids = owned_locked(owner);
+    }
+    for (uint64_t id : ids)
+        pause(id);
+}
+
+void CueScheduler::resume_owner(uint64_t owner)
+{
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ids = owned_locked(owner);
+    }
+    for (uint64_t id : ids)
+        resume(id);
+}
+
+std::vector<uint64_t> CueScheduler::owned_locked(uint64_t owner) const
+{
+    std::vector<uint64_t> ids;
+    for (const auto& entry : timers) {
+        if (entry.second.owner == owner)
+            ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+void CueScheduler::arm_countdown(Timer& timer, gint64 now)
+{
+    timer.countdown_us = 0;
+    if (timer.wait == Wait::None)
+        return;
+    // Next moment the displayed whole seconds drop; the last one is the deadline
+    int seconds = seconds_left(timer.deadline_us - now);
+    if (seconds > 1)
+        timer.countdown_us = timer.deadline_us - (seconds - 1) * second_us;
+}
+
+void CueScheduler::insert_locked(Timer& timer)
+{
+    timer.due_us = timer.countdown_us > 0 ? std::min(timer.deadline_us, timer.countdown_us)
+                                          : timer.deadline_us;
+    slots[static_cast<size_t>(timer.due_us / tick_us) % slot_count].push_back({timer.id, timer.due_us});
+    cond.notify_one();
+}
+
+void CueScheduler::push_countdown_locked(const Timer& timer, gint64 now, bool done)
+{
+    Event event;
+    event.timer = timer.id;
+    event.fire = false;
+    event.deadline_us = timer.deadline_us;
+    event.countdown.timer = timer.id;
+    event.countdown.owner = timer.owner;
+    event.countdown.wait = timer.wait;
+    event.countdown.paused = timer.paused;
+    event.countdown.done = done;
+    event.countdown.remaining_seconds = done ? 0 : seconds_left(timer.paused ? timer.remaining_us
+                                                                             : timer.deadline_us - now);
+    events.push_back(event);
+}
+
+void CueScheduler::collect_slot_locked(size_t slot, gint64 now, std::vector<uint64_t>& due)
+{
+    auto& entries = slots[slot];
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const SlotEntry& entry = entries[i];
+        auto it = timers.find(entry.id);
+        bool live = it != timers.end() && !it->second.paused && !it->second.fired
+                 && it->second.due_us == entry.due_us;
+        if (!live)
+            continue;
+        if (entry.due_us <= now) {
+            due.push_back(entry.id);
+            continue;
+        }
+        entries[kept++] = entry; // a later turn of the wheel
+    }
+    entries.resize(kept);
+}
+
+gint64 CueScheduler::next_due_locked(gint64 now_tick) const
+{
+    for (size_t offset = 0; offset < slot_count; ++offset) {
+        gint64 tick = now_tick + static_cast<gint64>(offset);
+        gint64 best = 0;
+        for (const SlotEntry& entry : slots[static_cast<size_t>(tick) % slot_count]) {
+            if (entry.due_us / tick_us != tick)
+                continue;
+            auto it = timers.find(entry.id);
+            if (it == timers.end() || it->second.paused || it->second.fired || it->second.due_us != entry.due_us)
+                continue;
+            if (best == 0 || entry.due_us < best)
+                best = entry.due_us;
+        }
+        if (best != 0)
+            return best;
+    }
+    // Nothing within one turn: wake up to advance the wheel
+    return (now_tick + static_cast<gint64>(slot_count)) * tick_us;
+}
+
+void CueScheduler::thread_main()
+{
+    // Wake as close to the deadline as the kernel allows
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    trace_set_thread_name("cue scheduler");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    gint64 last_tick = now_us() / tick_us;
+    std::vector<uint64_t> due;
+    std::vector<Action> on_time;
+
+    while (!stopping) {
+        gint64 now = now_us();
+        gint64 now_tick = now / tick_us;
+
+        due.clear();
+        if (now_tick - last_tick >= static_cast<gint64>(slot_count)) {
+            for (size_t slot = 0; slot < slot_count; ++slot)
+                collect_slot_locked(slot, now, due);
+        } else {
+            for (gint64 tick = last_tick; tick <= now_tick; ++tick)
+                collect_slot_locked(static_cast<size_t>(tick) % slot_count, now, due);
+        }
+        last_tick = now_tick;
+
+        on_time.clear();
+        for (uint64_t id : due) {
+            Timer& timer = timers[id];
+            if (timer.deadline_us > now) {
+                // A whole-second boundary of a countdown
+                push_countdown_locked(timer, now, false);
+                arm_countdown(timer, now);
+                insert_locked(timer);
+                continue;
+            }
+
+            if (timer.on_time)
+                on_time.push_back(timer.on_time);
+            events.push_back({id, true, timer.deadline_us, Countdown()});
+            if (timer.wait != Wait::None)
+                push_countdown_locked(timer, now, true);
+
+            if (timer.period_us > 0) {
+                // Stay in phase; periods missed entirely are skipped
+                do
+                    timer.deadline_us += timer.period_us;
+                while (timer.deadline_us <= now);
+                insert_locked(timer);
+            } else {
+                timer.fired = true;
+            }
+        }
+        if (!events.empty())
+            post_locked();
+
+        if (!on_time.empty()) {
+            // Taken before the timers lock is dropped, so cancel() waits for these
+            std::unique_lock<std::mutex> running(on_time_mutex);
+            lock.unlock();
+            for (auto& action : on_time)
+                action();
+            on_time.clear();
+            running.unlock();
+            lock.lock();
+            continue;
+        }
+
+        gint64 next = next_due_locked(now_tick);
+        cond.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(next)));
+    }
+}
+
+void CueScheduler::post_locked()
+{
+    if (delivery_source)
+        return;
+    delivery_source = g_idle_source_new();
+    g_source_set_priority(delivery_source, G_PRIORITY_HIGH);
+    g_source_set_callback(delivery_source, &CueScheduler::on_deliver, this, nullptr);
+    g_source_attach(delivery_source, nullptr);
+}
+
+gboolean CueScheduler::on_deliver(gpointer data)
+{
+    static_cast<CueScheduler*>(data)->deliver();
+    return G_SOURCE_REMOVE;
+}
+
+void CueScheduler::deliver()
+{
+    std::deque<Event> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(events);
+        g_source_unref(delivery_source);
+        delivery_source = nullptr;
+    }
+
+    for (const auto& event : ready) {
+        if (!event.fire) {
+            if (countdown_listener)
+                countdown_listener(event.countdown);
+            continue;
+        }
+
+        Action action;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = timers.find(event.timer);
+            if (it == timers.end())
+                continue; // cancelled after it expired
+            action = it->second.action;
+            if (it->second.period_us == 0)
+                timers.erase(it);
+        }
+
+        gint64 late = now_us() - event.deadline_us;
+        stats.fired++;
+        stats.max_late_us = std::max(stats.max_late_us, late);
+        if (late > late_warning_us)
+            std::cerr << "Scheduled action delivered " << late / 1000.0 << " ms late" << std::endl;
+        if (action)
+            action();
+    }
+}
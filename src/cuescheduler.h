@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glib.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Timing for prewait, postwait and slideshow advance, with millisecond
+// resolution on the monotonic clock.
+//
+// A timer thread keeps the waits in a hashed timer wheel (1 ms slots) and
+// sleeps until the nearest deadline with minimal timer slack. Expiries reach
+// the main thread through one G_PRIORITY_HIGH source, ahead of input, redraw
+// and other default-priority work. An optional `on_time` action runs on the
+// timer thread exactly at the deadline, for thread-safe work such as setting
+// a pipeline to PLAYING that must not wait for a busy main loop.
+//
+// Deadlines are absolute: repeating timers advance by whole periods, so they
+// do not drift, and pausing a wait keeps its remaining time for resume().
+class CueScheduler
+{
+public:
+    enum class Wait { None, Prewait, Postwait };
+    using Action = std::function<void()>;
+
+    // Countdown state of a Prewait/Postwait timer, published on start, every
+    // whole second, pause, resume and when it fires or is cancelled
+    struct Countdown {
+        uint64_t timer = 0;
+        uint64_t owner = 0;
+        Wait wait = Wait::None;
+        int remaining_seconds = 0;
+        bool paused = false;
+        bool done = false;
+    };
+    using CountdownListener = std::function<void(const Countdown&)>;
+
+    struct Stats {
+        uint64_t fired = 0;
+        gint64 max_late_us = 0; // deadline to main thread delivery
+    };
+
+    CueScheduler();
+    ~CueScheduler();
+
+    CueScheduler(const CueScheduler&) = delete;
+    CueScheduler& operator=(const CueScheduler&) = delete;
+
+    // `owner` groups the timers of one cue for cancel_owner()/pause_owner().
+    // Returns a timer id, never 0. Main thread.
+    uint64_t schedule(int delay_ms, Action action, uint64_t owner = 0,
+                      Wait wait = Wait::None, Action on_time = nullptr);
+    uint64_t schedule_every(int period_ms, Action action, uint64_t owner = 0);
+
+    // After cancel() returns, neither action of the timer runs. on_time
+    // actions must not call back into the scheduler.
+    void cancel(uint64_t timer);
+    void cancel_owner(uint64_t owner);
+    void pause(uint64_t timer);
+    void resume(uint64_t timer);
+    void pause_owner(uint64_t owner);
+    void resume_owner(uint64_t owner);
+
+    void set_countdown_listener(CountdownListener listener) { countdown_listener = std::move(listener); }
+    const Stats& get_stats() const { return stats; }
+
+private:
+    static constexpr gint64 tick_us = 1000;
+    static constexpr size_t slot_count = 1024; // one turn of the wheel is ~1 s
+
+    struct Timer {
+        uint64_t id = 0;
+        uint64_t owner = 0;
+        Wait wait = Wait::None;
+        gint64 deadline_us = 0;
+        gint64 period_us = 0;       // 0: one-shot
+        gint64 countdown_us = 0;    // next whole-second boundary, 0: none
+        gint64 due_us = 0;          // wheel position, min(deadline, countdown)
+        gint64 remaining_us = 0;    // while paused
+        bool paused = false;
+        bool fired = false;         // one-shot expired, delivery pending
+        Action action;
+        Action on_time;
+    };
+    struct SlotEntry {
+        uint64_t id;
+        gint64 due_us;
+    };
+    struct Event {
+        uint64_t timer;
+        bool fire;                  // else a countdown update
+        gint64 deadline_us;
+        Countdown countdown;
+    };
+
+    static gint64 now_us();
+    void thread_main();
+    void insert_locked(Timer& timer);
+    void arm_countdown(Timer& timer, gint64 now);
+    void push_countdown_locked(const Timer& timer, gint64 now, bool done);
+    void collect_slot_locked(size_t slot, gint64 now, std::vector<uint64_t>& due);
+    gint64 next_due_locked(gint64 now_tick) const;
+    void post_locked();
+    static gboolean on_deliver(gpointer data);
+    void deliver();
+    std::vector<uint64_t> owned_locked(uint64_t owner) const;
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::mutex on_time_mutex;       // held while on_time actions run
+    std::condition_variable cond;
+    bool stopping = false;
+
+    std::unordered_map<uint64_t, Timer> timers;
+    std::vector<std::vector<SlotEntry>> slots;
+    uint64_t next_id = 1;
+    std::deque<Event> events;
+    GSource* delivery_source = nullptr;
+
+    // Main thread only
+    CountdownListener countdown_listener;
+    Stats stats;
+};
@@ -0,0 +1,318 @@
+#include "editjournal.h"
+#include "showfile.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace {
+const char* const journal_header = "stageshow-journal ";
+
+bool write_all(int fd, const std::string& text)
+{
+    const char* p = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+size_t to_size(const std::string& value)
+{
+    return static_cast<size_t>(g_ascii_strtoull(value.c_str(), nullptr, 10));
+}
+}
+
+EditJournal::EditJournal(const std::string& dir, size_t compact_after)
+: dir(dir),
+  compact_after(compact_after)
+{
+    g_mkdir_with_parents(dir.c_str(), 0755);
+    gchar* path = g_build_filename(dir.c_str(), "journal.log", nullptr);
+    journal_path = path;
+    g_free(path);
+
+    gchar* lock_path = g_build_filename(dir.c_str(), "lock", nullptr);
+    lock_fd = ::open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd >= 0 && ::flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(lock_fd);
+        lock_fd = -1;
+    }
+    if (lock_fd < 0) {
+        std::cerr << "Edit journal disabled, " << lock_path << " is held by another instance" << std::endl;
+        g_free(lock_path);
+        return;
+    }
+    g_free(lock_path);
+
+    writer = std::thread(&EditJournal::writer_main, this);
+}
+
+EditJournal::~EditJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    if (writer.joinable())
+        writer.join();
+    if (fd >= 0)
+        ::close(fd);
+    // Closing releases the flock
+    if (lock_fd >= 0)
+        ::close(lock_fd);
+}
+
+std::string EditJournal::default_dir()
+{
+    gchar* path = g_build_filename(g_get_user_data_dir(), "linux-stageshow", "recovery", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+std::string EditJournal::snapshot_path(uint64_t snapshot_generation) const
+{
+    std::string name = "snapshot-" + std::to_string(snapshot_generation) + ".show";
+    gchar* path = g_build_filename(dir.c_str(), name.c_str(), nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+bool EditJournal::recover(std::vector<std::shared_ptr<CueItem>>& cues, std::string& show_path)
+{
+    if (lock_fd < 0)
+        return false;
+
+    gchar* data = nullptr;
+    gsize length = 0;
+    if (!g_file_get_contents(journal_path.c_str(), &data, &length, nullptr))
+        return false;
+    std::string journal(data, length);
+    g_free(data);
+
+    if (journal.compare(0, strlen(journal_header), journal_header) != 0) {
+        std::cerr << "Ignoring damaged edit journal " << journal_path << std::endl;
+        return false;
+    }
+    size_t line_end = journal.find('\n');
+    if (line_end == std::string::npos)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation = g_ascii_strtoull(journal.c_str() + strlen(journal_header), nullptr, 10);
+    }
+
+    std::vector<std::shared_ptr<CueItem>> base;
+    std::string error;
+    if (!load_show(snapshot_path(generation), base, error)) {
+        std::cerr << "Cannot recover show: " << error << std::endl;
+        return false;
+    }
+    CueList list;
+    for (auto& cue : base)
+        list.push_back(cue);
+
+    // Replay complete lines only; a torn last line is an edit that never made it
+    size_t replayed = 0;
+    for (size_t start = line_end + 1; start < journal.size();) {
+        size_t end = journal.find('\n', start);
+        if (end == std::string::npos)
+            break;
+        std::string line = journal.substr(start, end - start);
+        start = end + 1;
+
+        size_t tab = line.find('\t');
+        std::string op = line.substr(0, tab);
+        std::string args = tab == std::string::npos ? "" : line.substr(tab + 1);
+        size_t next_tab = args.find('\t');
+        std::string first = args.substr(0, next_tab);
+        std::string rest = next_tab == std::string::npos ? "" : args.substr(next_tab + 1);
+
+        if (op == "path") {
+            show_path = unescape_field(args);
+        } else if (op == "insert" || op == "update") {
+            auto cue = decode_cue(rest, error);
+            if (!cue)
+                break;
+            size_t position = to_size(first);
+            if (op == "update") {
+                auto old = list.at(position);
+                if (!old)
+                    break;
+                list.remove(old->id);
+            }
+            list.insert(position, cue);
+        } else if (op == "remove") {
+            auto cue = list.at(to_size(first));
+            if (!cue)
+                break;
+            list.remove(cue->id);
+        } else if (op == "move") {
+            auto cue = list.at(to_size(first));
+            if (!cue)
+                break;
+            list.move(cue->id, to_size(rest));
+        }
+        replayed++;
+    }
+
+    list.for_each([&cues](const std::shared_ptr<CueItem>& cue) { cues.push_back(cue); });
+    std::cout << "Recovered " << cues.size() << " cues (" << replayed << " journaled edits)" << std::endl;
+    return true;
+}
+
+void EditJournal::snapshot(const CueList& cues, const std::string& show_path)
+{
+    push({Job::Type::Snapshot, encode_show(cues), show_path});
+    records_since_snapshot = 0;
+}
+
+void EditJournal::record_insert(size_t position, const CueItem& cue)
+{
+    push({Job::Type::Append, "insert\t" + std::to_string(position) + "\t" + encode_cue(cue) + "\n", ""});
+}
+
+void EditJournal::record_update(size_t position, const CueItem& cue)
+{
+    push({Job::Type::Append, "update\t" + std::to_string(position) + "\t" + encode_cue(cue) + "\n", ""});
+}
+
+void EditJournal::record_remove(size_t position)
+{
+    push({Job::Type::Append, "remove\t" + std::to_string(position) + "\n", ""});
+}
+
+void EditJournal::record_move(size_t from, size_t to)
+{
+    push({Job::Type::Append, "move\t" + std::to_string(from) + "\t" + std::to_string(to) + "\n", ""});
+}
+
+void EditJournal::record_show_path(const std::string& path)
+{
+    push({Job::Type::Append, "path\t" + escape_field(path) + "\n", ""});
+}
+
+void EditJournal::discard()
+{
+    push({Job::Type::Discard, "", ""});
+}
+
+void EditJournal::push(Job job)
+{
+    if (lock_fd < 0)
+        return;
+    if (job.type == Job::Type::Append)
+        records_since_snapshot++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    cond.notify_one();
+}
+
+void EditJournal::writer_main()
+{
+    for (;;) {
+        std::deque<Job> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                break;
+            batch.swap(jobs);
+        }
+
+        // Consecutive appends share one write and one sync
+        std::string records;
+        for (auto& job : batch) {
+            if (job.type == Job::Type::Append) {
+                records += job.text;
+                continue;
+            }
+            if (!records.empty()) {
+                write_records(records);
+                records.clear();
+            }
+            if (job.type == Job::Type::Snapshot)
+                write_snapshot(job.text, job.show_path);
+            else
+                remove_files();
+        }
+        if (!records.empty())
+            write_records(records);
+    }
+}
+
+void EditJournal::write_records(const std::string& text)
+{
+    if (fd < 0)
+        return;
+    if (!write_all(fd, text) || ::fdatasync(fd) != 0)
+        std::cerr << "Edit journal write failed: " << strerror(errno) << std::endl;
+}
+
+void EditJournal::write_snapshot(const std::string& contents, const std::string& show_path)
+{
+    uint64_t next = generation + 1;
+
+    GError* err = nullptr;
+    if (!g_file_set_contents(snapshot_path(next).c_str(), contents.data(),
+                             static_cast<gssize>(contents.size()), &err)) {
+        std::cerr << "Edit journal snapshot failed: " << (err ? err->message : "unknown") << std::endl;
+        g_clear_error(&err);
+        return;
+    }
+
+    // The new journal must be complete on disk before it replaces the old one
+    std::string head = journal_header + std::to_string(next) + "\n";
+    if (!show_path.empty())
+        head += "path\t" + escape_field(show_path) + "\n";
+    std::string temp_path = journal_path + ".tmp";
+    int new_fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (new_fd < 0 || !write_all(new_fd, head) || ::fsync(new_fd) != 0
+        || ::rename(temp_path.c_str(), journal_path.c_str()) != 0) {
+        std::cerr << "Edit journal switch failed: " << strerror(errno) << std::endl;
+        if (new_fd >= 0)
+            ::close(new_fd);
+        g_unlink(snapshot_path(next).c_str());
+        return;
+    }
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+
+    if (fd >= 0)
+        ::close(fd);
+    fd = new_fd;
+    if (generation > 0)
+        g_unlink(snapshot_path(generation).c_str());
+    generation = next;
+}
+
+void EditJournal::remove_files()
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    g_unlink(journal_path.c_str());
+    if (generation > 0)
+        g_unlink(snapshot_path(generation).c_str());
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cueitem.h"
+#include "cuelist.h"
+
+// Crash recovery for the cue list, kept in
+// $XDG_DATA_HOME/linux-stageshow/recovery.
+//
+// The state is a snapshot (a show file, snapshot-<generation>.show) plus
+// journal.log, an append-only list of the edits made since. The journal's
+// first line names the generation it extends. Edits are encoded on the
+// caller's thread and written by one writer thread: whatever queued up while
+// the previous fdatasync ran goes out in a single write and sync.
+//
+// snapshot() starts a new generation. It writes the new snapshot, switches
+// to a fresh journal by rename, and only then deletes the old snapshot, so
+// a crash at any point leaves a consistent snapshot/journal pair. A clean
+// exit calls discard(), so files that are present at startup mean the last
+// session did not end cleanly.
+//
+// The directory belongs to one instance at a time, by an flock() on its lock
+// file held for the journal's lifetime. A second instance started meanwhile
+// runs without a journal: it recovers nothing and records nothing, so it
+// never touches the running session's files.
+class EditJournal
+{
+public:
+    explicit EditJournal(const std::string& dir = default_dir(), size_t compact_after = 500);
+    ~EditJournal(); // writes out everything queued
+
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    // Rebuilds the cue list of an unclean exit. Call before anything is
+    // recorded; false when there is nothing to recover.
+    bool recover(std::vector<std::shared_ptr<CueItem>>& cues, std::string& show_path);
+
+    void snapshot(const CueList& cues, const std::string& show_path);
+    void record_insert(size_t position, const CueItem& cue);
+    void record_update(size_t position, const CueItem& cue);
+    void record_remove(size_t position);
+    void record_move(size_t from, size_t to);
+    void record_show_path(const std::string& path);
+
+    // Enough edits since the last snapshot that replay would slow down
+    bool wants_snapshot() const { return records_since_snapshot >= compact_after; }
+
+    void discard();
+
+    static std::string default_dir();
+
+private:
+    struct Job {
+        enum class Type { Append, Snapshot, Discard };
+        Type type;
+        std::string text;        // record lines, or the snapshot show file
+        std::string show_path;   // Snapshot only
+    };
+
+    void push(Job job);
+    void writer_main();
+    void write_records(const std::string& text);
+    void write_snapshot(const std::string& contents, const std::string& show_path);
+    void remove_files();
+    std::string snapshot_path(uint64_t generation) const;
+
+    std::string dir;
+    std::string journal_path;
+    int lock_fd = -1; // holds the directory; -1 when another instance does
+    size_t compact_after;
+    size_t records_since_snapshot = 0;
+
+    // Writer thread only, once started
+    int fd = -1;
+    uint64_t generation = 0;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job> jobs;
+    bool stopping = false;
+};
@@ -0,0 +1,130 @@
+#include "fade.h"
+#include <gst/controller/gstdirectcontrolbinding.h>
+#include <gst/controller/gstinterpolationcontrolsource.h>
+#include <cmath>
+#include <iostream>
+
+namespace {
+// Curves other than linear are approximated piecewise-linearly
+const int curve_points = 32;
+}
+
+const char* fade_curve_name(FadeCurve curve)
+{
+    switch (curve) {
+        case FadeCurve::Linear: return "Linear";
+        case FadeCurve::EqualPower: return "Equal power";
+        case FadeCurve::SCurve: return "S-curve";
+    }
+    return "Linear";
+}
+
+double fade_curve_value(FadeCurve curve, double from, double to, double t)
+{
+    switch (curve) {
+    case FadeCurve::Linear:
+        return from + (to - from) * t;
+    case FadeCurve::EqualPower:
+        // Rising: sin over the quarter period; falling: cos
+        if (to >= from)
+            return from + (to - from) * std::sin(t * M_PI / 2.0);
+        return to + (from - to) * std::cos(t * M_PI / 2.0);
+    case FadeCurve::SCurve:
+        return from + (to - from) * t * t * (3.0 - 2.0 * t);
+    }
+    return to;
+}
+
+bool fade_start(GstElement* pipeline, GstElement* volume, double target,
+                GstClockTime duration, FadeCurve curve)
+{
+    if (!pipeline || !volume)
+        return false;
+
+    // Control points live in stream time, which is what GstVolume syncs on
+    gint64 position = 0;
+    if (!gst_element_query_position(pipeline, GST_FORMAT_TIME, &position) || position < 0)
+        position = 0;
+    GstClockTime now = static_cast<GstClockTime>(position);
+
+    GstControlSource* source = nullptr;
+    GstControlBinding* binding = gst_object_get_control_binding(GST_OBJECT(volume), "volume");
+    if (binding) {
+        g_object_get(binding, "control-source", &source, nullptr);
+        gst_object_unref(binding);
+    } else {
+        // Bound lazily: a binding without points would make GstVolume fail
+        source = gst_interpolation_control_source_new();
+        g_object_set(source, "mode", GST_INTERPOLATION_MODE_LINEAR, nullptr);
+        gst_object_add_control_binding(GST_OBJECT(volume),
+            gst_direct_control_binding_new_absolute(GST_OBJECT(volume), "volume", source));
+    }
+
+    // Start from wherever a running fade has got to
+    gdouble from = 1.0;
+    if (!gst_control_source_get_value(source, now, &from))
+        g_object_get(volume, "volume", &from, nullptr);
+
+    auto* timed = GST_TIMED_VALUE_CONTROL_SOURCE(source);
+    gst_timed_value_control_source_unset_all(timed);
+
+    int points = (curve == FadeCurve::Linear || duration == 0) ? 1 : curve_points;
+    gst_timed_value_control_source_set(timed, now, from);
+    for (int i = 1; i <= points; ++i) {
+        double t = static_cast<double>(i) / points;
+        gst_timed_value_control_source_set(timed,
+            now + static_cast<GstClockTime>(duration * t),
+            fade_curve_value(curve, from, target, t));
+    }
+
+    gst_object_unref(source);
+    return true;
+}
+
+double fade_gain(GstElement* pipeline, GstElement* volume)
+{
+    gdouble gain = 1.0;
+    if (!volume)
+        return gain;
+    g_object_get(volume, "volume", &gain, nullptr);
+
+    GstControlBinding* binding = gst_object_get_control_binding(GST_OBJECT(volume), "volume");
+    if (!binding)
+        return gain;
+    GstControlSource* source = nullptr;
+    g_object_get(binding, "control-source", &source, nullptr);
+    gst_object_unref(binding);
+
+    gint64 position = 0;
+    if (!gst_element_query_position(pipeline, GST_FORMAT_TIME, &position) || position < 0)
+        position = 0;
+    gdouble value = 0.0;
+    if (source && gst_control_source_get_value(source, static_cast<GstClockTime>(position), &value))
+        gain = value;
+    if (source)
+        gst_object_unref(source);
+    return gain;
+}
+
+void fade_set(GstElement* volume, double gain)
+{
+    if (!volume)
+        return;
+
+    GstControlBinding* binding = gst_object_get_control_binding(GST_OBJECT(volume), "volume");
+    if (!binding) {
+        g_object_set(volume, "volume", gain, nullptr);
+        return;
+    }
+    GstControlSource* source = nullptr;
+    g_object_get(binding, "control-source", &source, nullptr);
+    gst_object_unref(binding);
+    if (!source)
+        return;
+
+    // A single point at the start holds for every position after it
+    auto* timed = GST_TIMED_VALUE_CONTROL_SOURCE(source);
+    gst_timed_value_control_source_unset_all(timed);
+    gst_timed_value_control_source_set(timed, 0, gain);
+    gst_object_unref(source);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <gst/gst.h>
+
+// Volume fades evaluated on the streaming thread. The curve is written into
+// an interpolation control source bound to a GstVolume element's "volume"
+// property; GstVolume pulls per-sample values from it, so fades are
+// sample-accurate and do not depend on the GTK main loop at all.
+
+enum class FadeCurve {
+    Linear,
+    EqualPower,
+    SCurve
+};
+
+const char* fade_curve_name(FadeCurve curve);
+
+// Gain of the curve at t (0..1) going from `from` to `to`
+double fade_curve_value(FadeCurve curve, double from, double to, double t);
+
+// Schedule a fade on `volume` (a GstVolume inside `pipeline`) starting at the
+// pipeline's current position. Replaces any fade still in progress, starting
+// from the gain it had reached.
+bool fade_start(GstElement* pipeline, GstElement* volume, double target,
+                GstClockTime duration, FadeCurve curve);
+
+// Gain `volume` has at the pipeline's current position
+double fade_gain(GstElement* pipeline, GstElement* volume);
+
+// Holds `volume` at `gain` for the whole stream, replacing any fade. For
+// where stream time starts over, as at a loop point, since fade control
+// points are in stream time.
+void fade_set(GstElement* volume, double gain);
@@ -0,0 +1,199 @@
+// Plays a show without a display: every cue in order through CueEngine, with
+// fakesinks for the program output and the audio device. For soak tests and
+// profiling on machines without a display server or sound card.
+//
+//   stageshow-headless <show> [loops] [hold_s]
+//
+// Each cue is held until it ends by itself or `hold_s` seconds after its
+// prewait (default 10), then stopped; the cue after it stands by meanwhile,
+// as it would when selected in the playlist. Cues that auto-continue are
+// followed rather than started again. Control cues run their commands.
+// After each loop everything still running is stopped. Exits non-zero if
+// any cue failed. The playback health of each audio and video cue is printed
+// as it is left behind. With STAGESHOW_TRACE set to a path, the cue trace is
+// written there on exit (see trace.h).
+
+#include <glibmm/init.h>
+#include <glibmm/main.h>
+#include <gst/gst.h>
+#include <cstdlib>
+#include <iostream>
+#include "cueengine.h"
+#include "cuescheduler.h"
+#include "showfile.h"
+#include "trace.h"
+
+namespace {
+
+class HeadlessRunner
+{
+public:
+    HeadlessRunner(CueEngine& engine, Glib::RefPtr<Glib::MainLoop> main_loop, int loops, int hold_ms)
+    : engine(engine), main_loop(std::move(main_loop)), loops(loops), hold_ms(hold_ms)
+    {
+        CueEngine::Listener listener;
+        listener.cue_started = [this](std::shared_ptr<CueItem>) { started++; };
+        listener.cue_failed = [this](std::shared_ptr<CueItem> cue, const std::string& error) {
+            failed++;
+            std::cerr << "Loop " << loop + 1 << ", cue " << engine_index(cue) + 1
+                      << " failed: " << error << std::endl;
+        };
+        engine.set_listener(listener);
+    }
+
+    void start()
+    {
+        loop_start_us = g_get_monotonic_time();
+        go(0);
+        poll_timer = engine.get_scheduler()->schedule_every(poll_ms, [this]() { on_poll(); });
+    }
+
+    int total_failed() const { return total_failures; }
+
+private:
+    static constexpr int poll_ms = 50;
+
+    int engine_index(const std::shared_ptr<CueItem>& cue) const
+    {
+        return cue ? engine.cues().index_of(cue->id) : -1;
+    }
+
+    void go(size_t index)
+    {
+        current = engine.cues().at(index);
+        if (!current)
+            return;
+        engine.go(current);
+        follow(current);
+        engine.set_standby(engine.cues().next(current->id));
+    }
+
+    // Starts holding `cue`, which the engine has already started
+    void follow(const std::shared_ptr<CueItem>& cue)
+    {
+        current = cue;
+        seen_running = false;
+        deadline_us = g_get_monotonic_time() + (static_cast<gint64>(cue->prewait) * 1000 + hold_ms) * 1000;
+    }
+
+    static void report_health(const std::shared_ptr<CueItem>& cue)
+    {
+        if (cue && (cue->type == CueItem::Type::Audio || cue->type == CueItem::Type::Video))
+            std::cout << "Health of " << cue->name << ": "
+                      << cue->health.describe(cue->type == CueItem::Type::Video) << std::endl;
+    }
+
+    void on_poll()
+    {
+        // auto_next moved on by itself
+        auto active = engine.get_active();
+        if (active && active != current && engine_index(active) >= 0) {
+            report_health(current);
+            follow(active);
+            engine.set_standby(engine.cues().next(active->id));
+            return;
+        }
+
+        bool running = engine.is_running(current);
+        seen_running = seen_running || running;
+        bool ended = seen_running && !running;
+        if (!ended && g_get_monotonic_time() < deadline_us)
+            return;
+
+        report_health(current);
+        if (running)
+            engine.stop(current);
+
+        auto next = engine.cues().next(current->id);
+        if (next) {
+            go(static_cast<size_t>(engine_index(next)));
+            return;
+        }
+
+        // End of the show
+        engine.stop_all();
+        std::cout << "Loop " << loop + 1 << ": " << started << " cues started, " << failed << " failed, "
+                  << (g_get_monotonic_time() - loop_start_us) / 1000000.0 << " s" << std::endl;
+        total_failures += failed;
+        started = 0;
+        failed = 0;
+
+        if (++loop >= loops) {
+            engine.get_scheduler()->cancel(poll_timer);
+            main_loop->quit();
+            return;
+        }
+        loop_start_us = g_get_monotonic_time();
+        go(0);
+    }
+
+    CueEngine& engine;
+    Glib::RefPtr<Glib::MainLoop> main_loop;
+    int loops;
+    int hold_ms;
+
+    std::shared_ptr<CueItem> current;
+    bool seen_running = false;
+    gint64 deadline_us = 0;
+    uint64_t poll_timer = 0;
+
+    int loop = 0;
+    gint64 loop_start_us = 0;
+    int started = 0;
+    int failed = 0;
+    int total_failures = 0;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    Glib::init();
+    gst_init(&argc, &argv);
+    trace_set_thread_name("main");
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <show> [loops] [hold_s]" << std::endl;
+        return 2;
+    }
+    int loops = argc > 2 ? std::atoi(argv[2]) : 1;
+    double hold_s = argc > 3 ? std::atof(argv[3]) : 10.0;
+    if (loops < 1)
+        loops = 1;
+
+    std::vector<std::shared_ptr<CueItem>> cues;
+    std::string error;
+    if (!load_show(argv[1], cues, error)) {
+        std::cerr << "Cannot open show " << argv[1] << ": " << error << std::endl;
+        return 1;
+    }
+    if (cues.empty()) {
+        std::cerr << "Show " << argv[1] << " has no cues" << std::endl;
+        return 1;
+    }
+
+    auto scheduler = std::make_shared<CueScheduler>();
+    CueEngine engine(scheduler, "fakesink");
+    for (const auto& cue : cues)
+        engine.cues().push_back(cue);
+
+    std::cout << cues.size() << " cues, " << loops << (loops == 1 ? " loop" : " loops")
+              << ", holding each for up to " << hold_s << " s" << std::endl;
+
+    auto main_loop = Glib::MainLoop::create();
+    HeadlessRunner runner(engine, main_loop, loops, static_cast<int>(hold_s * 1000));
+    runner.start();
+    main_loop->run();
+
+    engine.release_all();
+
+    const char* trace_path = g_getenv("STAGESHOW_TRACE");
+    if (trace_path && trace_enabled()) {
+        std::string path = trace_default_path();
+        std::string trace_error;
+        if (trace_dump(path, trace_error))
+            std::cout << "Trace written to " << path << std::endl;
+        else
+            std::cerr << "Cannot write trace: " << trace_error << std::endl;
+    }
+    return runner.total_failed() > 0 ? 1 : 0;
+}
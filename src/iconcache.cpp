@@ -0,0 +1,20 @@
+#include "iconcache.h"
+#include <iostream>
+
+Glib::RefPtr<Gdk::Pixbuf> IconCache::get(const std::string& name)
+{
+    auto it = icons.find(name);
+    if (it != icons.end())
+        return it->second;
+
+    // Failures are cached too, so a missing file is reported once
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    std::string path = std::string(STAGESHOW_DATA_DIR) + "/images/" + name + ".png";
+    try {
+        pixbuf = Gdk::Pixbuf::create_from_file(path);
+    } catch (const Glib::Error& e) {
+        std::cerr << "Error loading icon " << path << ": " << e.what() << std::endl;
+    }
+    icons[name] = pixbuf;
+    return pixbuf;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <gdkmm/pixbuf.h>
+#include <map>
+#include <string>
+
+// Button icons from STAGESHOW_DATA_DIR/images, each decoded once on first
+// use and shared by every Gtk::Image that shows it.
+class IconCache
+{
+public:
+    // `name` without directory or extension, e.g. "pause"; null if missing
+    Glib::RefPtr<Gdk::Pixbuf> get(const std::string& name);
+
+private:
+    std::map<std::string, Glib::RefPtr<Gdk::Pixbuf>> icons;
+};
@@ -9,6 +9,8 @@
 #include "playbackwindow.h"
 #include "cuepropertiesdialog.h"
 #include "cueitem.h"
+#include "cuescheduler.h"
+#include "trace.h"
 
 // Forward declarations
 class PlaybackWindow;
@@ -19,8 +21,10 @@ int main(int argc, char* argv[])
 {
     auto app = Gtk::Application::create(argc, argv, "org.media.cueplayer");
     gst_init(&argc, &argv);
-    auto playback_win = std::make_shared<PlaybackWindow>();
-    auto playlist_win = std::make_shared<PlaylistWindow>(playback_win);
+    trace_set_thread_name("main");
+    auto scheduler = std::make_shared<CueScheduler>();
+    auto playback_win = std::make_shared<PlaybackWindow>(scheduler);
+    auto playlist_win = std::make_shared<PlaylistWindow>(playback_win, scheduler);
     auto countdown_win = std::make_shared<CountdownWindow>();
 
     playlist_win->show_all();
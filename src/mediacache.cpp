@@ -0,0 +1,285 @@
+#include "mediacache.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char cache_magic[8] = {'S', 'S', 'M', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t cache_version = 2;
+const uint64_t initial_capacity = 4096;
+
+// Holds an flock() on the cache file for the scope
+class FileLock
+{
+public:
+    FileLock(int fd, int operation) : fd(fd) { locked = fd >= 0 && ::flock(fd, operation) == 0; }
+    ~FileLock() { if (locked) ::flock(fd, LOCK_UN); }
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+    explicit operator bool() const { return locked; }
+
+private:
+    int fd;
+    bool locked = false;
+};
+}
+
+MediaCache::MediaCache(const std::string& filename)
+: filename(filename)
+{
+    gchar* dir = g_path_get_dirname(filename.c_str());
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Media cache disabled, cannot open " << filename << std::endl;
+        return;
+    }
+
+    FileLock lock(fd, LOCK_EX);
+    if (!lock) {
+        std::cerr << "Media cache disabled, cannot lock " << filename << std::endl;
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    // Reuse the existing table when the header checks out, otherwise start over
+    Header existing {};
+    uint64_t capacity = initial_capacity;
+    bool valid = ::pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) && header_valid(existing);
+    if (valid)
+        capacity = existing.capacity;
+    else if (::ftruncate(fd, 0) != 0)
+        std::cerr << "Failed to reset media cache " << filename << std::endl;
+
+    // Without a mapping every access misses until one can be made
+    if (!map_file(capacity, true))
+        return;
+
+    if (!valid) {
+        std::memcpy(header->magic, cache_magic, sizeof(cache_magic));
+        header->version = cache_version;
+        header->record_size = sizeof(Record);
+        header->capacity = capacity;
+        header->count = 0;
+    }
+}
+
+MediaCache::~MediaCache()
+{
+    unmap_file();
+    if (fd >= 0)
+        ::close(fd);
+}
+
+std::string MediaCache::default_path()
+{
+    gchar* path = g_build_filename(g_get_user_cache_dir(), "linux-stageshow", "media.cache", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+bool MediaCache::header_valid(const Header& header)
+{
+    return std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0
+        && header.version == cache_version
+        && header.record_size == sizeof(Record)
+        && header.capacity >= initial_capacity
+        && (header.capacity & (header.capacity - 1)) == 0;
+}
+
+bool MediaCache::map_file(uint64_t capacity, bool resize)
+{
+    size_t size = sizeof(Header) + capacity * sizeof(Record);
+    if (resize && ::ftruncate(fd, size) != 0) {
+        std::cerr << "Failed to size media cache " << filename << std::endl;
+        return false;
+    }
+
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Failed to map media cache " << filename << std::endl;
+        return false;
+    }
+
+    mapping = addr;
+    mapping_size = size;
+    mapped_capacity = capacity;
+    header = static_cast<Header*>(addr);
+    records = reinterpret_cast<Record*>(static_cast<char*>(addr) + sizeof(Header));
+    return true;
+}
+
+void MediaCache::unmap_file()
+{
+    if (mapping) {
+        ::munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+        header = nullptr;
+        records = nullptr;
+        mapped_capacity = 0;
+    }
+}
+
+bool MediaCache::sync_mapping()
+{
+    // Called with the file locked. Another instance may have grown the table,
+    // or reset it to a smaller one; check the file before touching the
+    // mapping, which could now reach past its end.
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    Header current {};
+    if (::fstat(fd, &st) != 0 || ::pread(fd, &current, sizeof(current), 0) != sizeof(current)
+        || !header_valid(current)
+        || static_cast<uint64_t>(st.st_size) < sizeof(Header) + current.capacity * sizeof(Record)) {
+        unmap_file();
+        return false;
+    }
+    if (header && current.capacity == mapped_capacity)
+        return true;
+
+    unmap_file();
+    return map_file(current.capacity, false);
+}
+
+void MediaCache::grow()
+{
+    uint64_t old_capacity = header->capacity;
+    std::vector<Record> live;
+    live.reserve(header->count);
+    for (uint64_t i = 0; i < old_capacity; ++i) {
+        if (records[i].path_hash != 0)
+            live.push_back(records[i]);
+    }
+
+    unmap_file();
+    if (!map_file(old_capacity * 2, true))
+        return;
+
+    // ftruncate zero-fills the extension, the old half still needs clearing
+    std::memset(records, 0, old_capacity * sizeof(Record));
+    header->capacity = old_capacity * 2;
+    header->count = 0;
+    for (const auto& record : live) {
+        *find_slot(record.path_hash) = record;
+        header->count++;
+    }
+}
+
+MediaCache::Record* MediaCache::find_slot(uint64_t path_hash)
+{
+    // Linear probing; capacity is a power of two and never full
+    uint64_t mask = header->capacity - 1;
+    for (uint64_t i = path_hash & mask;; i = (i + 1) & mask) {
+        if (records[i].path_hash == path_hash || records[i].path_hash == 0)
+            return &records[i];
+    }
+}
+
+uint64_t MediaCache::hash_path(const std::string& path)
+{
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+uint64_t MediaCache::check_path(const std::string& path)
+{
+    // djb2, widened; unrelated to FNV so a collision in one is caught by the other
+    uint64_t hash = 5381;
+    for (unsigned char c : path)
+        hash = (hash * 33) ^ c;
+    return hash;
+}
+
+bool MediaCache::stat_file(const std::string& path, uint64_t& size, int64_t& mtime_ns)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+        return false;
+
+    size = static_cast<uint64_t>(st.st_size);
+    mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool MediaCache::lookup(const std::string& path, MediaInfo& info)
+{
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    if (!stat_file(path, size, mtime_ns))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    FileLock file_lock(fd, LOCK_SH);
+    if (!file_lock || !sync_mapping())
+        return false;
+
+    const Record* record = find_slot(hash_path(path));
+    if (record->path_hash == 0 || record->path_check != check_path(path)
+        || record->file_size != size || record->file_mtime_ns != mtime_ns)
+        return false;
+
+    info.duration = record->duration_ns;
+    info.width = record->width;
+    info.height = record->height;
+    info.audio_channels = record->audio_channels;
+    info.keyframe_interval_ms = record->keyframe_interval_ms;
+    info.caps.assign(record->caps, strnlen(record->caps, sizeof(record->caps)));
+    return true;
+}
+
+void MediaCache::store(const std::string& path, const MediaInfo& info)
+{
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    if (!stat_file(path, size, mtime_ns))
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    FileLock file_lock(fd, LOCK_EX);
+    if (!file_lock || !sync_mapping())
+        return;
+
+    uint64_t path_hash = hash_path(path);
+    Record* record = find_slot(path_hash);
+    if (record->path_hash == 0) {
+        if ((header->count + 1) * 10 > header->capacity * 7) {
+            grow();
+            if (!header)
+                return;
+            record = find_slot(path_hash);
+        }
+        header->count++;
+    }
+
+    record->path_hash = path_hash;
+    record->path_check = check_path(path);
+    record->file_size = size;
+    record->file_mtime_ns = mtime_ns;
+    record->duration_ns = info.duration;
+    record->width = info.width;
+    record->height = info.height;
+    record->audio_channels = info.audio_channels;
+    record->keyframe_interval_ms = info.keyframe_interval_ms;
+    std::memset(record->caps, 0, sizeof(record->caps));
+    std::memcpy(record->caps, info.caps.data(), std::min(info.caps.size(), sizeof(record->caps) - 1));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// What we know about a media file once it has been probed.
+struct MediaInfo {
+    GstClockTime duration = GST_CLOCK_TIME_NONE;
+    int width = 0;
+    int height = 0;
+    int audio_channels = 0;
+    int keyframe_interval_ms = 0; // 0 when unknown
+    std::string caps;             // e.g. "video/x-h264"
+};
+
+// Persistent media metadata cache, memory-mapped from
+// $XDG_CACHE_HOME/linux-stageshow/media.cache.
+//
+// The file is an open-addressed hash table of fixed-size records keyed by a
+// hash of the path, with a second, independent hash to tell colliding paths
+// apart. Each record also stores the file size and mtime it was probed at; a
+// lookup whose size or mtime no longer match is a miss, and the next store
+// overwrites the stale record in place.
+//
+// Several stageshow instances may share the file. Every access holds an
+// flock() on it, and the mapping is redone whenever another instance has
+// grown or reset the table since this one last looked.
+class MediaCache
+{
+public:
+    explicit MediaCache(const std::string& filename = default_path());
+    ~MediaCache();
+
+    MediaCache(const MediaCache&) = delete;
+    MediaCache& operator=(const MediaCache&) = delete;
+
+    bool lookup(const std::string& path, MediaInfo& info);
+    void store(const std::string& path, const MediaInfo& info);
+
+    static std::string default_path();
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t capacity;
+        uint64_t count;
+    };
+
+    struct Record {
+        uint64_t path_hash;   // 0 marks an empty slot
+        uint64_t path_check;  // second hash of the path
+        uint64_t file_size;
+        int64_t file_mtime_ns;
+        uint64_t duration_ns;
+        uint32_t width;
+        uint32_t height;
+        uint32_t audio_channels;
+        uint32_t keyframe_interval_ms;
+        char caps[64];
+    };
+
+    bool map_file(uint64_t capacity, bool resize);
+    void unmap_file();
+    bool sync_mapping();
+    void grow();
+    Record* find_slot(uint64_t path_hash);
+
+    static bool header_valid(const Header& header);
+    static uint64_t hash_path(const std::string& path);
+    static uint64_t check_path(const std::string& path);
+    static bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime_ns);
+
+    std::string filename;
+    int fd = -1;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    Header* header = nullptr;
+    Record* records = nullptr;
+    uint64_t mapped_capacity = 0;
+    std::mutex mutex;
+};
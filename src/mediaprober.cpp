@@ -0,0 +1,167 @@
+#include "mediaprober.h"
+#include <gst/pbutils/pbutils.h>
+#include <iostream>
+
+namespace {
+
+void fill_media_info(GstDiscovererInfo* info, MediaInfo& media)
+{
+    media.duration = gst_discoverer_info_get_duration(info);
+
+    GList* video = gst_discoverer_info_get_video_streams(info);
+    if (video) {
+        auto* video_info = GST_DISCOVERER_VIDEO_INFO(video->data);
+        media.width = gst_discoverer_video_info_get_width(video_info);
+        media.height = gst_discoverer_video_info_get_height(video_info);
+    }
+
+    GList* audio = gst_discoverer_info_get_audio_streams(info);
+    if (audio) {
+        auto* audio_info = GST_DISCOVERER_AUDIO_INFO(audio->data);
+        media.audio_channels = gst_discoverer_audio_info_get_channels(audio_info);
+    }
+
+    // Describe the primary stream by its caps name, e.g. "video/x-h264"
+    GList* primary = video ? video : audio;
+    if (primary) {
+        GstCaps* caps = gst_discoverer_stream_info_get_caps(GST_DISCOVERER_STREAM_INFO(primary->data));
+        if (caps) {
+            if (gst_caps_get_size(caps) > 0)
+                media.caps = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+            gst_caps_unref(caps);
+        }
+    }
+
+    // GstDiscoverer does not report the GOP length; keyframe_interval_ms stays
+    // 0 (unknown) until something that demuxes the stream fills it in.
+
+    gst_discoverer_stream_info_list_free(video);
+    gst_discoverer_stream_info_list_free(audio);
+}
+
+}
+
+MediaProber::MediaProber(unsigned concurrency, GstClockTime timeout)
+: concurrency(concurrency > 0 ? concurrency : 1),
+  timeout(timeout)
+{
+    dispatcher.connect(sigc::mem_fun(*this, &MediaProber::on_dispatch));
+    start_workers();
+}
+
+MediaProber::~MediaProber()
+{
+    stop_workers();
+}
+
+void MediaProber::probe(const std::string& path, Callback callback)
+{
+    Result cached;
+    if (cache.lookup(path, cached.info)) {
+        cached.path = path;
+        cached.ok = true;
+        cached.cached = true;
+        if (callback)
+            callback(cached);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({path, std::move(callback)});
+    }
+    cond.notify_one();
+}
+
+void MediaProber::set_concurrency(unsigned new_concurrency)
+{
+    if (new_concurrency == 0 || new_concurrency == concurrency)
+        return;
+
+    // Queued jobs survive the restart; only in-flight probes are waited for
+    stop_workers();
+    concurrency = new_concurrency;
+    start_workers();
+}
+
+void MediaProber::start_workers()
+{
+    stopping = false;
+    for (unsigned i = 0; i < concurrency; ++i)
+        workers.emplace_back(&MediaProber::worker_main, this);
+}
+
+void MediaProber::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void MediaProber::worker_main()
+{
+    GError* err = nullptr;
+    GstDiscoverer* discoverer = gst_discoverer_new(timeout, &err);
+    if (!discoverer) {
+        std::cerr << "Failed to create discoverer: " << (err ? err->message : "unknown") << std::endl;
+        g_clear_error(&err);
+        return;
+    }
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                break;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Result result;
+        result.path = job.path;
+
+        gchar* uri = gst_filename_to_uri(job.path.c_str(), nullptr);
+        GstDiscovererInfo* info = uri ? gst_discoverer_discover_uri(discoverer, uri, &err) : nullptr;
+        if (info && gst_discoverer_info_get_result(info) == GST_DISCOVERER_OK) {
+            result.ok = true;
+            fill_media_info(info, result.info);
+            cache.store(job.path, result.info);
+        } else {
+            std::cerr << "Probe failed for " << job.path << ": "
+                      << (err ? err->message : "no result") << std::endl;
+        }
+        g_clear_error(&err);
+        if (info)
+            g_object_unref(info);
+        g_free(uri);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.push_back({std::move(result), std::move(job.callback)});
+        }
+        dispatcher.emit();
+    }
+
+    g_object_unref(discoverer);
+}
+
+void MediaProber::on_dispatch()
+{
+    // One wakeup may carry several results
+    std::deque<Done> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(done);
+    }
+    for (auto& item : ready) {
+        if (item.callback)
+            item.callback(item.result);
+    }
+}
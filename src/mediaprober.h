@@ -0,0 +1,66 @@
+#pragma once
+
+#include "mediacache.h"
+#include <glibmm/dispatcher.h>
+#include <gst/gst.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Probes media files with GstDiscoverer on a pool of worker threads.
+// Each worker owns its discoverer and runs it synchronously, so probing never
+// touches the GTK main loop; results are handed back through a Glib::Dispatcher
+// and the callbacks run on the main thread.
+//
+// The persistent MediaCache is consulted first: a hit is answered immediately
+// without building a discoverer pipeline, and every successful probe is stored.
+class MediaProber
+{
+public:
+    struct Result {
+        std::string path;
+        bool ok = false;
+        bool cached = false;
+        MediaInfo info;
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    explicit MediaProber(unsigned concurrency = 4, GstClockTime timeout = 5 * GST_SECOND);
+    ~MediaProber();
+
+    void probe(const std::string& path, Callback callback);
+    void set_concurrency(unsigned concurrency);
+    unsigned get_concurrency() const { return concurrency; }
+
+private:
+    struct Job {
+        std::string path;
+        Callback callback;
+    };
+    struct Done {
+        Result result;
+        Callback callback;
+    };
+
+    void start_workers();
+    void stop_workers();
+    void worker_main();
+    void on_dispatch();
+
+    unsigned concurrency;
+    GstClockTime timeout;
+    MediaCache cache;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job> jobs;
+    std::deque<Done> done;
+    bool stopping = false;
+
+    Glib::Dispatcher dispatcher;
+};
@@ -0,0 +1,245 @@
+#include "outputgraph.h"
+#include <algorithm>
+#include <iostream>
+
+OutputGraph::OutputGraph(int width, int height, int fps, int layer_count, int max_layer_count)
+: max_layers(static_cast<size_t>(std::max(layer_count, max_layer_count))),
+  width(width),
+  height(height)
+{
+    pipeline = gst_pipeline_new("program-output");
+    compositor = gst_element_factory_make("compositor", nullptr);
+    GstElement* capsfilter = gst_element_factory_make("capsfilter", nullptr);
+    GstElement* convert = gst_element_factory_make("videoconvert", nullptr);
+    GstElement* sink = gst_element_factory_make("gtksink", nullptr);
+    if (!compositor || !capsfilter || !convert || !sink) {
+        std::cerr << "Program output: missing compositor/gtksink elements" << std::endl;
+        return;
+    }
+
+    // Layers carry opaque frames; the background only shows when all are hidden
+    g_object_set(compositor, "background", 1 /* black */, nullptr);
+    GstCaps* caps = gst_caps_new_simple("video/x-raw",
+                                        "width", G_TYPE_INT, width,
+                                        "height", G_TYPE_INT, height,
+                                        "framerate", GST_TYPE_FRACTION, fps, 1,
+                                        nullptr);
+    g_object_set(capsfilter, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+
+    gst_bin_add_many(GST_BIN(pipeline), compositor, capsfilter, convert, sink, nullptr);
+    gst_element_link_many(compositor, capsfilter, convert, sink, nullptr);
+
+    for (int i = 0; i < layer_count; ++i)
+        add_layer();
+
+    // Pushed one buffer at a time with no duration, which the compositor
+    // repeats until the next one arrives
+    hold_src = gst_element_factory_make("appsrc", "hold");
+    if (hold_src) {
+        g_object_set(hold_src, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", TRUE, nullptr);
+        gst_bin_add(GST_BIN(pipeline), hold_src);
+        gst_element_link(hold_src, compositor);
+
+        GstPad* src_pad = gst_element_get_static_pad(hold_src, "src");
+        hold_pad = gst_pad_get_peer(src_pad);
+        gst_object_unref(src_pad);
+        g_object_set(hold_pad, "alpha", 0.0, "zorder", 0, nullptr);
+    }
+
+    g_object_get(sink, "widget", &widget, nullptr);
+
+    // intervideosrc is live, so the output runs (black) from the start
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+}
+
+bool OutputGraph::add_layer()
+{
+    GstElement* src = gst_element_factory_make("intervideosrc", nullptr);
+    if (!src)
+        return false;
+
+    gchar* channel = channel_name(static_cast<int>(layers.size()));
+    g_object_set(src, "channel", channel, nullptr);
+    g_free(channel);
+
+    gst_bin_add(GST_BIN(pipeline), src);
+    if (!gst_element_link(src, compositor)) {
+        gst_bin_remove(GST_BIN(pipeline), src);
+        return false;
+    }
+
+    Layer layer;
+    GstPad* src_pad = gst_element_get_static_pad(src, "src");
+    layer.pad = gst_pad_get_peer(src_pad);
+    gst_object_unref(src_pad);
+    layer.zorder = ++top_zorder;
+    g_object_set(layer.pad, "alpha", 0.0, "zorder", layer.zorder, nullptr);
+    layers.push_back(layer);
+
+    // Added to the running output, it joins from here
+    gst_element_sync_state_with_parent(src);
+    return true;
+}
+
+OutputGraph::~OutputGraph()
+{
+    if (pipeline) {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        for (auto& layer : layers) {
+            unbind(layer);
+            if (layer.pad)
+                gst_object_unref(layer.pad);
+        }
+        if (hold_pad)
+            gst_object_unref(hold_pad);
+        gst_object_unref(pipeline);
+    }
+    if (widget)
+        g_object_unref(widget);
+}
+
+gchar* OutputGraph::channel_name(int layer)
+{
+    return g_strdup_printf("stageshow-layer-%d", layer);
+}
+
+GstElement* OutputGraph::create_cue_sink(int& layer)
+{
+    layer = -1;
+    if (layers.empty() || !layers[0].pad)
+        return nullptr;
+
+    // The free layer shown longest ago
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (!layers[i].busy && (layer < 0 || layers[i].last_used < layers[layer].last_used))
+            layer = static_cast<int>(i);
+    }
+    if (layer < 0) {
+        if (layers.size() >= max_layers || !add_layer()) {
+            std::cerr << "Program output: all " << layers.size() << " layers busy" << std::endl;
+            return nullptr;
+        }
+        layer = static_cast<int>(layers.size()) - 1;
+    }
+    unbind(layers[layer]);
+    layers[layer].busy = true;
+    layers[layer].last_used = ++use_counter;
+    layers[layer].shown = false;
+    g_object_set(layers[layer].pad, "alpha", 0.0, nullptr);
+
+    // Scale on the cue's streaming thread so the compositor only blits
+    GError* err = nullptr;
+    GstElement* bin = gst_parse_bin_from_description(
+        "videoconvert ! videoscale add-borders=true ! capsfilter name=scalecaps ! intervideosink name=layersink",
+        TRUE, &err);
+    if (!bin) {
+        std::cerr << "Program output: cannot build cue sink: " << (err ? err->message : "unknown") << std::endl;
+        g_clear_error(&err);
+        layers[layer].busy = false;
+        layer = -1;
+        return nullptr;
+    }
+
+    GstElement* scalecaps = gst_bin_get_by_name(GST_BIN(bin), "scalecaps");
+    GstCaps* caps = gst_caps_new_simple("video/x-raw",
+                                        "width", G_TYPE_INT, width,
+                                        "height", G_TYPE_INT, height,
+                                        "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                                        nullptr);
+    g_object_set(scalecaps, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+    gst_object_unref(scalecaps);
+
+    GstElement* layersink = gst_bin_get_by_name(GST_BIN(bin), "layersink");
+    gchar* channel = channel_name(layer);
+    g_object_set(layersink, "channel", channel, nullptr);
+    g_free(channel);
+    // Kept for hold_layer(), which reads its last sample
+    layers[layer].sink = layersink;
+
+    return bin;
+}
+
+void OutputGraph::show_layer(int layer)
+{
+    if (layer < 0 || layer >= static_cast<int>(layers.size()))
+        return;
+
+    // Newest cue on top; it takes over from a held frame
+    layers[layer].last_used = ++use_counter;
+    layers[layer].shown = true;
+    layers[layer].zorder = ++top_zorder;
+    g_object_set(layers[layer].pad, "alpha", 1.0, "zorder", layers[layer].zorder, nullptr);
+    release_hold();
+}
+
+void OutputGraph::release_layer(int layer)
+{
+    if (layer < 0 || layer >= static_cast<int>(layers.size()))
+        return;
+
+    layers[layer].busy = false;
+    layers[layer].shown = false;
+    unbind(layers[layer]);
+    g_object_set(layers[layer].pad, "alpha", 0.0, nullptr);
+}
+
+bool OutputGraph::hold_layer(int layer)
+{
+    if (layer < 0 || layer >= static_cast<int>(layers.size()))
+        return false;
+
+    // A hidden layer has nothing on screen to keep
+    GstSample* sample = nullptr;
+    if (layers[layer].shown && layers[layer].sink && hold_pad)
+        g_object_get(layers[layer].sink, "last-sample", &sample, nullptr);
+
+    bool held = false;
+    GstBuffer* buffer = sample ? gst_sample_get_buffer(sample) : nullptr;
+    if (buffer) {
+        // A shallow copy shares the frame's memory; only the timing is reset,
+        // so appsrc stamps it now and it never expires
+        GstBuffer* frame = gst_buffer_copy(buffer);
+        GST_BUFFER_PTS(frame) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_DTS(frame) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_DURATION(frame) = GST_CLOCK_TIME_NONE;
+        GstSample* still = gst_sample_new(frame, gst_sample_get_caps(sample), nullptr, nullptr);
+        gst_buffer_unref(frame);
+
+        GstFlowReturn ret = GST_FLOW_ERROR;
+        g_signal_emit_by_name(hold_src, "push-sample", still, &ret);
+        gst_sample_unref(still);
+        held = ret == GST_FLOW_OK;
+    }
+    if (sample)
+        gst_sample_unref(sample);
+
+    if (held) {
+        // Where the layer was, so a newer cue above it stays on top; the
+        // layer is hidden below, so sharing its zorder shows nothing else
+        holding = true;
+        g_object_set(hold_pad, "alpha", 1.0, "zorder", layers[layer].zorder, nullptr);
+    } else {
+        std::cerr << "Program output: no frame to hold on layer " << layer << std::endl;
+    }
+    release_layer(layer);
+    return held;
+}
+
+void OutputGraph::release_hold()
+{
+    // The compositor keeps the hidden frame until the next hold replaces it
+    if (!holding)
+        return;
+    holding = false;
+    g_object_set(hold_pad, "alpha", 0.0, nullptr);
+}
+
+void OutputGraph::unbind(Layer& layer)
+{
+    if (layer.sink) {
+        gst_object_unref(layer.sink);
+        layer.sink = nullptr;
+    }
+}
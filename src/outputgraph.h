@@ -0,0 +1,78 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <gtk/gtk.h>
+#include <vector>
+
+// The long-lived program output: a fixed set of layers composited into one
+// gtksink. The pipeline and its widget are built once and run for the whole
+// session.
+//
+// Each layer is an intervideosrc on its own channel feeding a compositor pad.
+// A video cue gets a sink bin (scale to the output size, then intervideosink
+// on a free layer's channel) to use as its playbin video-sink. Switching
+// cues only changes compositor pad properties; nothing in the output
+// pipeline or the widget tree is rebuilt, so a switch costs at most one
+// output frame.
+//
+// Standby pipelines hold layers too, so when all are busy another is added
+// to the running compositor, up to `max_layers`. Past that create_cue_sink()
+// fails; a layer is never shared, as releasing it for one cue would hide
+// the other.
+//
+// One more input, above the layers when in use, holds a still frame: the
+// last sample a cue's sink rendered, pushed once and repeated by the
+// compositor, so a finished video can stay on screen after its pipeline is
+// gone.
+class OutputGraph
+{
+public:
+    OutputGraph(int width = 1920, int height = 1080, int fps = 60, int layers = 4, int max_layers = 16);
+    ~OutputGraph();
+
+    OutputGraph(const OutputGraph&) = delete;
+    OutputGraph& operator=(const OutputGraph&) = delete;
+
+    GtkWidget* get_widget() const { return widget; }
+
+    // Video sink bin for a cue pipeline, bound to a free layer (stored in
+    // `layer`); nullptr when every layer up to max_layers is busy. The layer
+    // stays transparent until show_layer().
+    GstElement* create_cue_sink(int& layer);
+    void show_layer(int layer);
+    void release_layer(int layer);
+    // Keeps the layer's last rendered frame on screen, at the layer's place
+    // in the stack, and frees the layer. Call before the cue pipeline leaves
+    // PLAYING; the frame is held until the next show_layer() or
+    // release_hold(). False if the layer was not shown.
+    bool hold_layer(int layer);
+    void release_hold();
+
+private:
+    struct Layer {
+        GstPad* pad = nullptr; // compositor sink pad
+        GstElement* sink = nullptr; // the cue's intervideosink, while bound
+        bool busy = false;
+        bool shown = false;
+        int zorder = 0;
+        guint64 last_used = 0;
+    };
+
+    static gchar* channel_name(int layer);
+    bool add_layer();
+
+    void unbind(Layer& layer);
+
+    GstElement* pipeline = nullptr;
+    GstElement* compositor = nullptr;
+    GstElement* hold_src = nullptr; // appsrc for the held frame
+    GstPad* hold_pad = nullptr;     // its compositor sink pad
+    bool holding = false;
+    GtkWidget* widget = nullptr;
+    std::vector<Layer> layers;
+    guint64 use_counter = 0;
+    int top_zorder = 0;
+    size_t max_layers;
+    int width;
+    int height;
+};
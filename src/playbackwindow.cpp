@@ -1,10 +1,31 @@
 #include "playbackwindow.h"
+#include <algorithm>
 
 #if defined(GDK_WINDOWING_X11)
 #include <gdk/gdkx.h>
 #endif
 
-PlaybackWindow::PlaybackWindow()
+namespace {
+
+Glib::RefPtr<Gdk::Pixbuf> ensure_rgba(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+{
+    return pixbuf->get_has_alpha() ? pixbuf : pixbuf->add_alpha(false, 0, 0, 0);
+}
+
+RgbaFrame frame_of(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+{
+    RgbaFrame frame;
+    frame.data = pixbuf->get_pixels();
+    frame.width = pixbuf->get_width();
+    frame.height = pixbuf->get_height();
+    frame.stride = pixbuf->get_rowstride();
+    return frame;
+}
+
+}
+
+PlaybackWindow::PlaybackWindow(std::shared_ptr<CueScheduler> cue_scheduler)
+: scheduler(std::move(cue_scheduler))
 {
     set_title("Media Playback");
     set_default_size(640, 480);
@@ -28,6 +49,19 @@ PlaybackWindow::PlaybackWindow()
     video_container.signal_size_allocate().connect(
         sigc::mem_fun(*this, &PlaybackWindow::on_video_container_resized));
 
+    // Both pages are packed once for the lifetime of the window
+    output_stack.set_hexpand(true);
+    output_stack.set_vexpand(true);
+    output_stack.set_transition_type(Gtk::STACK_TRANSITION_TYPE_NONE);
+    output_stack.add(slideshow_image, "image");
+    if (output_graph.get_widget()) {
+        video_output = Glib::wrap(output_graph.get_widget());
+        video_output->set_hexpand(true);
+        video_output->set_vexpand(true);
+        output_stack.add(*video_output, "video");
+    }
+    video_container.pack_start(output_stack);
+
     // Initially show fallback or empty image
     set_video_container_content(slideshow_image);
 
@@ -35,17 +69,60 @@ PlaybackWindow::PlaybackWindow()
     video_container.show_all();
 
     signal_key_press_event().connect(sigc::mem_fun(*this, &PlaybackWindow::on_key_press));
+    slide_decoder.signal_ready().connect(sigc::mem_fun(*this, &PlaybackWindow::on_slide_decoded));
+}
+
+PlaybackWindow::~PlaybackWindow()
+{
+    scheduler->cancel(slideshow_timer);
 }
 
 void PlaybackWindow::set_fallback_image(const std::string& path)
 {
-    try {
-        auto pixbuf = Gdk::Pixbuf::create_from_file(path);
-		fallback_pixbuf_original = pixbuf;
-		update_fallback_image_scaled();
-        set_video_container_content(slideshow_image);
-    } catch (...) {
-        std::cerr << "Failed to load fallback image: " << path << std::endl;
+    // Decode each fallback file once; later calls just swap it back in
+    if (!path.empty() && (path != fallback_loaded_path || !fallback_pixbuf_original)) {
+        try {
+            fallback_pixbuf_original = Gdk::Pixbuf::create_from_file(path);
+            fallback_loaded_path = path;
+            fallback_scaled.reset();
+        } catch (...) {
+            std::cerr << "Failed to load fallback image: " << path << std::endl;
+            if (!fallback_pixbuf_original)
+                return;
+        }
+    }
+    show_fallback();
+}
+
+void PlaybackWindow::show_fallback()
+{
+    finish_transition();
+    output_graph.release_hold();
+
+    if (!fallback_pixbuf_original) {
+        try {
+            fallback_pixbuf_original = Gdk::Pixbuf::create_from_file(fallback_image_path);
+            fallback_loaded_path = fallback_image_path;
+        } catch (...) {
+            std::cerr << "Failed to load fallback image: " << fallback_image_path << std::endl;
+            return;
+        }
+    }
+
+    showing_fallback = true;
+    displayed_slide_index = -1;
+    single_slide_path.clear();
+    update_fallback_image_scaled();
+    set_video_container_content(slideshow_image);
+}
+
+void PlaybackWindow::get_output_size(int& width, int& height)
+{
+    width = output_width;
+    height = output_height;
+    if (width <= 0 || height <= 0) {
+        width = video_container.get_allocated_width();
+        height = video_container.get_allocated_height();
     }
 }
 
@@ -54,48 +131,91 @@ void PlaybackWindow::update_fallback_image_scaled()
     if (!fallback_pixbuf_original)
         return;
 
-    int width = slideshow_image.get_allocated_width();
-    int height = slideshow_image.get_allocated_height();
-
+    int width, height;
+    get_output_size(width, height);
     if (width <= 0 || height <= 0)
         return;
 
-    auto scaled = fallback_pixbuf_original->scale_simple(
-        width, height, Gdk::INTERP_BILINEAR);
-    
-    slideshow_image.set(scaled);
+    if (!fallback_scaled || fallback_scaled->get_width() != width || fallback_scaled->get_height() != height)
+        fallback_scaled = fallback_pixbuf_original->scale_simple(width, height, Gdk::INTERP_BILINEAR);
+
+    if (showing_fallback)
+        set_displayed(fallback_scaled);
 }
 
 void PlaybackWindow::on_image_size_allocate(Gtk::Allocation& allocation)
 {
+    schedule_rescale(allocation.get_width(), allocation.get_height());
+}
+
+void PlaybackWindow::schedule_rescale(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    // Setting a scaled image re-allocates at the same size; ignore that echo
+    if (width == output_width && height == output_height && !resize_debounce.connected())
+        return;
+
+    pending_width = width;
+    pending_height = height;
+    resize_debounce.disconnect();
+    resize_debounce = Glib::signal_timeout().connect([this]() {
+        apply_output_size();
+        return false;
+    }, 80);
+}
+
+void PlaybackWindow::apply_output_size()
+{
+    finish_transition();
+    output_width = pending_width;
+    output_height = pending_height;
+
+    // Keep the fallback resident at the new size even while a slide is up
     update_fallback_image_scaled();
+    // Slideshow slides are re-decoded off the main thread and swapped in as
+    // they arrive (on_slide_decoded); a single slide is reloaded here
+    update_slide_decode_size();
+    if (!showing_fallback && displayed_slide_index < 0 && !single_slide_path.empty())
+        show_slide_file(single_slide_path);
 }
 
 void PlaybackWindow::set_video_container_content(Gtk::Widget& widget)
 {
-    // Remove all children
-    std::vector<Gtk::Widget*> to_remove;
-    video_container.foreach([&](Gtk::Widget& child) {
-        to_remove.push_back(&child);
-    });
-    for (auto* w : to_remove)
-        video_container.remove(*w);
-
-    video_container.pack_start(widget);
+    if (widget.get_parent() != &output_stack) {
+        std::cerr << "set_video_container_content: widget is not an output page" << std::endl;
+        return;
+    }
+    output_stack.set_visible_child(widget);
     widget.show();
 }
 
-void PlaybackWindow::on_video_container_resized(Gtk::Allocation& allocation)
+GstElement* PlaybackWindow::create_video_sink(int& layer)
 {
-    if (!current_pixbuf_original)
-        return;
+    return output_graph.create_cue_sink(layer);
+}
+
+void PlaybackWindow::show_video_layer(int layer)
+{
+    finish_transition();
+    output_graph.show_layer(layer);
+    if (video_output)
+        set_video_container_content(*video_output);
+}
+
+void PlaybackWindow::release_video_layer(int layer)
+{
+    output_graph.release_layer(layer);
+}
 
-    auto scaled = current_pixbuf_original->scale_simple(
-        allocation.get_width(),
-        allocation.get_height(),
-        Gdk::INTERP_BILINEAR
-    );
-    slideshow_image.set(scaled);
+bool PlaybackWindow::hold_video_layer(int layer)
+{
+    return output_graph.hold_layer(layer);
+}
+
+void PlaybackWindow::on_video_container_resized(Gtk::Allocation& allocation)
+{
+    schedule_rescale(allocation.get_width(), allocation.get_height());
 }
 
 void PlaybackWindow::pause_audio() {
@@ -133,26 +253,36 @@ void PlaybackWindow::audio_volume_up() {
     }
 }
 
-void PlaybackWindow::start_slideshow(const std::vector<std::string>& files, int slideshow_interval_seconds)
+void PlaybackWindow::start_slideshow(const std::vector<std::string>& files, int slideshow_interval_seconds,
+                                     TransitionType transition, int transition_ms)
 {
     if (files.empty())
         return;
 
+    // A held video frame gives way to the slides
+    output_graph.release_hold();
+    slide_transition = transition;
+    slide_transition_ms = transition_ms;
+    displayed_slide_index = -1;
+    single_slide_path.clear();
+
     slideshow_files = files;
     slideshow_index = 0; // start from the beginning
     slideshow_playing = true;
+    pending_slide_index = -1;
+
+    update_slide_decode_size();
+    slide_decoder.set_files(slideshow_files);
 
     show_slide(slideshow_index);
 
-    // start auto-advance every 5 seconds (or interval)
-    if (slideshow_timer.connected())
-        slideshow_timer.disconnect();
+    // Auto-advance on whole intervals from now, without drift
+    scheduler->cancel(slideshow_timer);
+    slideshow_timer = 0;
 	std::cout << "Interval: " << slideshow_interval_seconds << std::endl;
-	if (!slideshow_interval_seconds == 0){
-		slideshow_timer = Glib::signal_timeout().connect(
-		    sigc::mem_fun(*this, &PlaybackWindow::on_slideshow_tick),
-		    slideshow_interval_seconds * 1000
-		);
+	if (slideshow_interval_seconds > 0) {
+		slideshow_timer = scheduler->schedule_every(slideshow_interval_seconds * 1000,
+		                                            [this]() { on_slideshow_tick(); });
 	}
 }
 
@@ -161,58 +291,200 @@ void PlaybackWindow::show_slide(int index)
     if (index < 0 || index >= static_cast<int>(slideshow_files.size()))
         return;
 
-    std::string filepath = slideshow_files[index];
-    try {
-        current_pixbuf_original = Gdk::Pixbuf::create_from_file(filepath);
-        update_scaled_slide_image();
+    // Re-centre the prefetch ring; this also queues the slide if it is missing
+    slide_decoder.set_position(index);
+
+    auto pixbuf = slide_decoder.get(index);
+    if (!pixbuf) {
+        // Keep the current image up until the decoder delivers this one
+        pending_slide_index = index;
+        return;
+    }
+
+    pending_slide_index = -1;
+    if (index == displayed_slide_index && pixbuf == current_pixbuf) {
+        // Already shown, or transitioning towards it
         set_video_container_content(slideshow_image);
-    } catch (const Glib::FileError& e) {
-        std::cerr << "File error: " << e.what() << std::endl;
-    } catch (const Gdk::PixbufError& e) {
-        std::cerr << "Pixbuf error: " << e.what() << std::endl;
+        return;
+    }
+
+    bool animate = slide_transition != TransitionType::Cut && slide_transition_ms > 0
+                && displayed_pixbuf && index != displayed_slide_index;
+    current_pixbuf = pixbuf;
+    displayed_slide_index = index;
+    single_slide_path.clear();
+
+    if (animate) {
+        showing_fallback = false;
+        start_transition(current_pixbuf);
+    } else {
+        update_scaled_slide_image();
+    }
+    set_video_container_content(slideshow_image);
+}
+
+void PlaybackWindow::on_slide_decoded(int index)
+{
+    if (index == pending_slide_index) {
+        show_slide(index);
+        return;
+    }
+
+    // The slide on screen, re-decoded for a new output size
+    auto pixbuf = slide_decoder.get(index);
+    if (pixbuf && index == displayed_slide_index && !showing_fallback && pixbuf != current_pixbuf) {
+        current_pixbuf = pixbuf;
+        update_scaled_slide_image();
+    }
+}
+
+void PlaybackWindow::update_slide_decode_size()
+{
+    // Slides are decoded to the output size, so nothing is scaled here
+    int width, height;
+    get_output_size(width, height);
+    slide_decoder.set_output_size(width, height);
+
+    // Until that is known, decode no larger than the monitor the output window is on
+    auto window = get_window();
+    if (!window) {
+        slide_decoder.set_max_size(0, 0);
+        return;
     }
+
+    auto screen = get_screen();
+    Gdk::Rectangle geometry;
+    screen->get_monitor_geometry(screen->get_monitor_at_window(window), geometry);
+    slide_decoder.set_max_size(geometry.get_width(), geometry.get_height());
 }
 
 void PlaybackWindow::update_scaled_slide_image()
 {
-    if (!current_pixbuf_original)
+    if (!current_pixbuf)
         return;
 
-    int width = slideshow_image.get_allocated_width();
-    int height = slideshow_image.get_allocated_height();
+    finish_transition();
 
-	if (width <= 0 || height <= 0) {
-	    std::cout << "Invalid image area size: " << width << "x" << height << std::endl;
-    return;
-	}
-    auto scaled = current_pixbuf_original->scale_simple(
-        width, height, Gdk::INTERP_BILINEAR);
+    showing_fallback = false;
+
+    // Already at the output size, from the decoder or show_slide_file()
+    set_displayed(current_pixbuf);
+}
 
-    slideshow_image.set(scaled);
+void PlaybackWindow::set_displayed(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+{
+    displayed_pixbuf = pixbuf;
+    slideshow_image.set(pixbuf);
+}
+
+void PlaybackWindow::start_transition(const Glib::RefPtr<Gdk::Pixbuf>& target)
+{
+    finish_transition();
+
+    if (!displayed_pixbuf || !target
+        || displayed_pixbuf->get_width() != target->get_width()
+        || displayed_pixbuf->get_height() != target->get_height()) {
+        set_displayed(target);
+        return;
+    }
+
+    // Both ends are already scaled to the output; only the RGBA layout may differ
+    transition_from = ensure_rgba(displayed_pixbuf);
+    transition_to = ensure_rgba(target);
+    displayed_pixbuf = target;
+
+    int width = target->get_width();
+    int height = target->get_height();
+    for (auto& out : transition_out) {
+        if (!out || out->get_width() != width || out->get_height() != height)
+            out = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+    }
+
+    transition_start_us = -1;
+    transition_tick_id = slideshow_image.add_tick_callback(
+        sigc::mem_fun(*this, &PlaybackWindow::on_transition_tick));
+}
+
+void PlaybackWindow::finish_transition()
+{
+    if (!transition_tick_id)
+        return;
+
+    slideshow_image.remove_tick_callback(transition_tick_id);
+    transition_tick_id = 0;
+    transition_from.reset();
+    transition_to.reset();
+    slideshow_image.set(displayed_pixbuf);
+}
+
+bool PlaybackWindow::on_transition_tick(const Glib::RefPtr<Gdk::FrameClock>& clock)
+{
+    gint64 now = clock->get_frame_time();
+    if (transition_start_us < 0)
+        transition_start_us = now;
+
+    double progress = (now - transition_start_us) / (slide_transition_ms * 1000.0);
+    if (progress >= 1.0) {
+        transition_tick_id = 0;
+        transition_from.reset();
+        transition_to.reset();
+        slideshow_image.set(displayed_pixbuf);
+        return false;
+    }
+
+    auto out = transition_out[transition_out_index];
+    transition_out_index ^= 1;
+    transition_renderer.render(slide_transition, progress,
+                               frame_of(transition_from), frame_of(transition_to), frame_of(out));
+    slideshow_image.set(out);
+    return true;
 }
 
 void PlaybackWindow::show_slide_file(const std::string& filepath)
 {
+    // Slides of the running slideshow come from the prefetch ring
+    auto it = std::find(slideshow_files.begin(), slideshow_files.end(), filepath);
+    if (it != slideshow_files.end()) {
+        slideshow_index = std::distance(slideshow_files.begin(), it);
+        show_slide(slideshow_index);
+        return;
+    }
+
+    int width, height;
+    get_output_size(width, height);
+    if (width <= 0 || height <= 0) {
+        std::cout << "Invalid image area size: " << width << "x" << height << std::endl;
+        return;
+    }
+
     try {
-        current_pixbuf_original = Gdk::Pixbuf::create_from_file(filepath);
+        current_pixbuf = Gdk::Pixbuf::create_from_file(filepath, width, height, false);
+        single_slide_path = filepath;
+        displayed_slide_index = -1;
         update_scaled_slide_image();
     } catch (const Glib::Error& e) {
         std::cerr << "Error loading slide " << filepath << ": " << e.what() << std::endl;
     }
 }
 
-bool PlaybackWindow::on_slideshow_tick()
+void PlaybackWindow::on_slideshow_tick()
 {
     if (!slideshow_playing)
-        return true;
+        return;
 
-    slideshow_index++;
-    if (slideshow_index >= static_cast<int>(slideshow_files.size()))
-        slideshow_index = 0;
+    int next_index = slideshow_index + 1;
+    if (next_index >= static_cast<int>(slideshow_files.size()))
+        next_index = 0;
 
-    show_slide(slideshow_index);
+    // Only ever swap in a decoded slide; a late decode holds the current one
+    // for another interval instead of stalling the main loop
+    if (!slide_decoder.get(next_index)) {
+        std::cerr << "Slide " << next_index << " not decoded yet, holding" << std::endl;
+        return;
+    }
 
-    return true;
+    slideshow_index = next_index;
+    show_slide(slideshow_index);
 }
 
 void PlaybackWindow::slideshow_next()
@@ -235,20 +507,28 @@ void PlaybackWindow::slideshow_prev()
 
 void PlaybackWindow::slideshow_pause()
 {
+    // The interval keeps its remaining time until resumed
     slideshow_playing = false;
+    scheduler->pause(slideshow_timer);
 }
 
 void PlaybackWindow::slideshow_resume()
 {
     slideshow_playing = true;
+    scheduler->resume(slideshow_timer);
 }
 
 void PlaybackWindow::slideshow_stop()
 {
-    if (slideshow_timer.connected())
-        slideshow_timer.disconnect();
+    scheduler->cancel(slideshow_timer);
+    slideshow_timer = 0;
     slideshow_playing = false;
 
+    // Release the prefetch ring
+    slideshow_files.clear();
+    slide_decoder.set_files(slideshow_files);
+    pending_slide_index = -1;
+
     image_scrolled.hide();
     video_container.show();
 }
@@ -4,16 +4,31 @@
 #include <gst/gst.h>
 #include <gst/video/videooverlay.h>
 #include <iostream>
+#include <memory>
+#include "cuescheduler.h"
+#include "slidedecoder.h"
+#include "transition.h"
+#include "outputgraph.h"
 
 class PlaybackWindow : public Gtk::Window
 {
 public:
-    PlaybackWindow();
+    explicit PlaybackWindow(std::shared_ptr<CueScheduler> scheduler);
+    ~PlaybackWindow();
 	void set_fallback_image(const std::string& path);
+	void show_fallback();
 
     void start_video(const std::string& filename);
-	void start_slideshow(const std::vector<std::string>& files, int slideshow_interval_seconds);
+	void start_slideshow(const std::vector<std::string>& files, int slideshow_interval_seconds,
+	                     TransitionType transition = TransitionType::Cut, int transition_ms = 0);
 	void set_video_container_content(Gtk::Widget& widget);
+
+	// program output layers for video cues
+	GstElement* create_video_sink(int& layer);
+	void show_video_layer(int layer);
+	void release_video_layer(int layer);
+	// keeps the layer's last frame up after its cue pipeline is gone
+	bool hold_video_layer(int layer);
 	void on_video_container_resized(Gtk::Allocation& allocation);
 
 	void pause_video();
@@ -38,6 +53,10 @@ public:
 protected:
     // video
     Gtk::Box video_container {Gtk::ORIENTATION_VERTICAL};
+    // program output and the image page share one stack; switching never re-packs
+    Gtk::Stack output_stack;
+    OutputGraph output_graph;
+    Gtk::Widget* video_output = nullptr;
     GstElement* playbin = nullptr;
 
     // slideshow
@@ -46,14 +65,51 @@ protected:
     std::vector<std::string> slideshow_files;
     int slideshow_index = 0;
     bool slideshow_playing = false;
-    sigc::connection slideshow_timer;
+    std::shared_ptr<CueScheduler> scheduler;
+    uint64_t slideshow_timer = 0; // CueScheduler timer advancing the slides
+    SlideDecoder slide_decoder;
+    int pending_slide_index = -1; // requested but not decoded yet
 	Glib::RefPtr<Gdk::Pixbuf> fallback_pixbuf_original;
-	Glib::RefPtr<Gdk::Pixbuf> current_pixbuf_original;
+	Glib::RefPtr<Gdk::Pixbuf> current_pixbuf; // at the output size
+	std::string single_slide_path; // shown by show_slide_file(), outside a slideshow
 	std::string fallback_image_path = std::string(STAGESHOW_DATA_DIR) + "/images/fallback.png";
+	std::string fallback_loaded_path;
+	// fallback pre-scaled to the output size, so returning to it is a pointer swap
+	Glib::RefPtr<Gdk::Pixbuf> fallback_scaled;
+	bool showing_fallback = false;
+
+	// output size, updated once resizing settles
+	int output_width = 0;
+	int output_height = 0;
+	int pending_width = 0;
+	int pending_height = 0;
+	sigc::connection resize_debounce;
+
+	// slide transitions, rendered on the frame clock
+	TransitionType slide_transition = TransitionType::Cut;
+	int slide_transition_ms = 0;
+	TransitionRenderer transition_renderer;
+	Glib::RefPtr<Gdk::Pixbuf> displayed_pixbuf; // settled image on slideshow_image
+	int displayed_slide_index = -1;
+	Glib::RefPtr<Gdk::Pixbuf> transition_from;
+	Glib::RefPtr<Gdk::Pixbuf> transition_to;
+	Glib::RefPtr<Gdk::Pixbuf> transition_out[2]; // ping-pong so every frame is a new pixbuf
+	int transition_out_index = 0;
+	guint transition_tick_id = 0;
+	gint64 transition_start_us = -1;
 
     // helpers
     void show_slide(int index);
-    bool on_slideshow_tick();
+    void on_slideshow_tick();
+    void on_slide_decoded(int index);
+    void schedule_rescale(int width, int height);
+    void apply_output_size();
+    void get_output_size(int& width, int& height);
+    void set_displayed(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf);
+    void start_transition(const Glib::RefPtr<Gdk::Pixbuf>& target);
+    void finish_transition();
+    bool on_transition_tick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+    void update_slide_decode_size();
 
     // fullscreen
     bool on_key_press(GdkEventKey* key_event);
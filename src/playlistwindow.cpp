@@ -3,6 +3,9 @@
 #include <gdk/gdkx.h>
 #endif
 #include "utils.h"
+#include "showfile.h"
+#include "trace.h"
+#include <algorithm>
 #include <iostream>
 #include <gtkmm.h>
 #include <gtkmm/application.h>
@@ -11,8 +14,11 @@
 #include <glibmm/main.h>
 #include <glibmm/miscutils.h>
 
-PlaylistWindow::PlaylistWindow(std::shared_ptr<PlaybackWindow> pw)
-: playback_window(pw)
+PlaylistWindow::PlaylistWindow(std::shared_ptr<PlaybackWindow> pw, std::shared_ptr<CueScheduler> cue_scheduler)
+: playback_window(pw),
+  scheduler(std::move(cue_scheduler)),
+  engine(scheduler),
+  cue_list(engine.cues())
 {
     set_title("Playlist Manager");
     set_default_size(1000, 700);
@@ -27,6 +33,18 @@ PlaylistWindow::PlaylistWindow(std::shared_ptr<PlaybackWindow> pw)
     file_menuitem->set_submenu(*file_menu);
     menu_bar.append(*file_menuitem);
 
+    auto open_item = Gtk::make_managed<Gtk::MenuItem>("Open Show...");
+    open_item->signal_activate().connect(sigc::mem_fun(*this, &PlaylistWindow::on_open_show));
+    file_menu->append(*open_item);
+
+    auto save_item = Gtk::make_managed<Gtk::MenuItem>("Save Show");
+    save_item->signal_activate().connect([this]() { on_save_show(false); });
+    file_menu->append(*save_item);
+
+    auto save_as_item = Gtk::make_managed<Gtk::MenuItem>("Save Show As...");
+    save_as_item->signal_activate().connect([this]() { on_save_show(true); });
+    file_menu->append(*save_as_item);
+
     auto preferences_item = Gtk::make_managed<Gtk::MenuItem>("Preferences");
     preferences_item->signal_activate().connect(sigc::mem_fun(*this, &PlaylistWindow::on_preferences_clicked));
     file_menu->append(*preferences_item);
@@ -49,6 +67,9 @@ PlaylistWindow::PlaylistWindow(std::shared_ptr<PlaybackWindow> pw)
     left_top_grid.attach(label_playing, 1, 1, 1, 1);
 
     cue_store = Gtk::ListStore::create(cue_columns);
+    progress_service = std::make_unique<ProgressService>(
+        cue_treeview, cue_store,
+        ProgressService::Columns{cue_columns.live, cue_columns.action_progress, cue_columns.action_text});
     cue_treeview.set_model(cue_store);
     cue_treeview.append_column("•", cue_columns.live);
     cue_treeview.append_column("#", cue_columns.number);
@@ -112,29 +133,45 @@ PlaylistWindow::PlaylistWindow(std::shared_ptr<PlaybackWindow> pw)
     item_add_control.signal_activate().connect(sigc::mem_fun(*this, &PlaylistWindow::add_command_cue));
 
 	cue_store->signal_rows_reordered().connect(sigc::mem_fun(*this, &PlaylistWindow::on_rows_reordered));
+    cue_store->signal_row_inserted().connect(sigc::mem_fun(*this, &PlaylistWindow::on_row_inserted));
+    cue_store->signal_row_deleted().connect(sigc::mem_fun(*this, &PlaylistWindow::on_row_deleted));
 
     cue_treeview.add_events(Gdk::KEY_PRESS_MASK | Gdk::BUTTON_PRESS_MASK);
     cue_treeview.signal_key_press_event().connect(sigc::mem_fun(*this, &PlaylistWindow::on_treeview_key_press), false);
     cue_treeview.signal_button_press_event().connect(sigc::mem_fun(*this, &PlaylistWindow::on_right_click), false);
     cue_treeview.signal_row_activated().connect(sigc::mem_fun(*this, &PlaylistWindow::on_row_activated));
+    cue_treeview.get_selection()->signal_changed().connect(sigc::mem_fun(*this, &PlaylistWindow::on_selection_changed));
 
     go_button.signal_clicked().connect(sigc::mem_fun(*this, &PlaylistWindow::on_go_clicked));
-    Glib::signal_timeout().connect(sigc::mem_fun(*this, &PlaylistWindow::on_timeout), 500);
+    engine.set_output(engine_output());
+    engine.set_listener(engine_listener());
+    scheduler->set_countdown_listener(sigc::mem_fun(*this, &PlaylistWindow::on_countdown));
+    button_global_fadeup.signal_clicked().connect(sigc::mem_fun(*this, &PlaylistWindow::on_global_fadeup));
+    button_global_fadedown.signal_clicked().connect(sigc::mem_fun(*this, &PlaylistWindow::on_global_fadedown));
+    health_timer = Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &PlaylistWindow::on_health_timer), 1);
 
     show_all_children();
+
+    // Restore the cue list of a session that did not exit cleanly
+    std::vector<std::shared_ptr<CueItem>> recovered;
+    std::string recovered_path;
+    if (journal.recover(recovered, recovered_path))
+        load_cues(recovered, recovered_path);
+    journal.snapshot(cue_list, show_path);
+
+    control_server.start(ControlServer::default_path(), [this](const ControlServer::Command& command) {
+        return on_control_command(command);
+    });
 }
 
 
 PlaylistWindow::~PlaylistWindow()
 {
-    for (auto& cue : cue_items)
-    {
-        if (cue->gst_pipeline)
-        {
-            gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
-            gst_object_unref(cue->gst_pipeline);
-        }
-    }
+    health_timer.disconnect();
+    control_server.stop();
+    engine.release_all();
+    // Clean exit: nothing to recover next time
+    journal.discard();
 }
 
 void PlaylistWindow::add_audio_cue()
@@ -154,101 +191,13 @@ void PlaylistWindow::add_audio_cue()
             res.loop_forever,
             res.last_frame
         );
-        cue_items.push_back(cue);
-
-        // --- Create control box for cue ---
-        auto control_box = Gtk::make_managed<Gtk::Grid>();
-
-        auto label = Gtk::make_managed<Gtk::Label>("Audio Cue: " + cue->name);
-        auto but_pause_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/pause.png");
-        auto but_stop_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/stop.png");
-        auto but_vol_down_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/fade_down.png");
-        auto but_vol_up_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/fade_up.png");
-        auto but_remove_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/close.png");
-
-        auto button_playpause = Gtk::make_managed<Gtk::ToggleButton>();
-        auto button_stop = Gtk::make_managed<Gtk::Button>();
-        auto button_vol_down = Gtk::make_managed<Gtk::Button>();
-        auto button_vol_up = Gtk::make_managed<Gtk::Button>();
-        auto button_remove = Gtk::make_managed<Gtk::Button>();
-
-        button_playpause->set_image(*but_pause_img);
-        button_stop->set_image(*but_stop_img);
-        button_vol_down->set_image(*but_vol_down_img);
-        button_vol_up->set_image(*but_vol_up_img);
-        button_remove->set_image(*but_remove_img);
-
-        control_box->attach(*label,             0, 0, 3, 1);
-        control_box->attach(*button_playpause,  0, 1, 1, 1);
-        control_box->attach(*button_stop,       1, 1, 1, 1);
-        control_box->attach(*button_remove,     2, 1, 1, 1);
-        control_box->attach(*button_vol_down,   1, 2, 1, 1);
-        control_box->attach(*button_vol_up,     2, 2, 1, 1);
-
-        // --- Signal handlers ---
-        button_playpause->signal_toggled().connect([this, cue, button_playpause]() {
-            if (!cue->gst_pipeline)
-                return;
-
-            if (button_playpause->get_active()) {
-                gst_element_set_state(cue->gst_pipeline, GST_STATE_PAUSED);
-                button_playpause->set_image_from_icon_name("media-playback-start");
-            } else {
-                gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
-                button_playpause->set_image_from_icon_name("media-playback-pause");
-            }
-        });
-
-        button_stop->signal_clicked().connect([cue]() {
-            if (cue->gst_pipeline)
-                gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
-        });
-
-        button_vol_down->signal_clicked().connect([cue]() {
-            Glib::signal_timeout().connect([cue]() -> bool {
-                gdouble vol = 1.0;
-                g_object_get(cue->gst_pipeline, "volume", &vol, nullptr);
-                vol -= 0.05;
-                if (vol <= 0.0) {
-                    vol = 0.0;
-                    g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-                    return false;
-                }
-                g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-                return true;
-            }, 100);
-        });
-
-        button_vol_up->signal_clicked().connect([cue]() {
-            Glib::signal_timeout().connect([cue]() -> bool {
-                gdouble vol = 0.0;
-                g_object_get(cue->gst_pipeline, "volume", &vol, nullptr);
-                vol += 0.05;
-                if (vol >= 1.0) {
-                    vol = 1.0;
-                    g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-                    return false;
-                }
-                g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-                return true;
-            }, 100);
-        });
-
-        button_remove->signal_clicked().connect([this, cue]() {
-            remove_cue(cue);
-        });
-
-        control_box->show_all();
-        per_cue_controls_box.pack_start(*control_box, Gtk::PACK_SHRINK);
-        cue_control_boxes[cue] = control_box;
-
-        // Add to model
-        auto row = *(cue_store->append());
-        row[cue_columns.name] = cue->name;
-        row[cue_columns.prewait] = Glib::ustring::format(res.prewait_seconds / 60, ":", res.prewait_seconds % 60);
-        row[cue_columns.action_text] = get_media_duration_hms(cue->path_or_command);
-        row[cue_columns.action_progress] = 0;
-        row[cue_columns.postwait] = Glib::ustring::format(res.postwait_seconds / 60, ":", res.postwait_seconds % 60);
+        cue->fade_ms = res.fade_ms;
+        cue->fade_target = res.fade_target;
+        cue->fade_curve = res.fade_curve;
+        cue->loop_crossfade_ms = res.loop_crossfade_ms;
+        cue_list.push_back(cue);
+        journal_insert(cue);
+        request_media_duration(cue, append_cue_row(cue));
     }
 }
 
@@ -271,91 +220,12 @@ void PlaylistWindow::add_video_cue()
         res.loop_forever,
         res.last_frame
     );
-    cue_items.push_back(cue);
-
-    // Create control box
-    auto control_box = Gtk::make_managed<Gtk::Grid>();
-
-    auto label = Gtk::make_managed<Gtk::Label>("Video Cue: " + cue->name);
-    auto but_pause_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/pause.png");
-    auto but_stop_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/stop.png");
-    auto but_vol_down_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/fade_down.png");
-    auto but_vol_up_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/fade_up.png");
-    auto but_remove_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/close.png");
-
-    auto button_playpause = Gtk::make_managed<Gtk::ToggleButton>();
-    auto button_stop = Gtk::make_managed<Gtk::Button>();
-    auto button_vol_down = Gtk::make_managed<Gtk::Button>();
-    auto button_vol_up = Gtk::make_managed<Gtk::Button>();
-    auto button_remove = Gtk::make_managed<Gtk::Button>();
-
-    button_playpause->set_image(*but_pause_img);
-    button_stop->set_image(*but_stop_img);
-    button_vol_down->set_image(*but_vol_down_img);
-    button_vol_up->set_image(*but_vol_up_img);
-    button_remove->set_image(*but_remove_img);
-
-    control_box->attach(*label,             0, 0, 3, 1);
-    control_box->attach(*button_playpause,  0, 1, 1, 1);
-    control_box->attach(*button_stop,       1, 1, 1, 1);
-    control_box->attach(*button_remove,     2, 1, 1, 1);
-    control_box->attach(*button_vol_down,   1, 2, 1, 1);
-    control_box->attach(*button_vol_up,     2, 2, 1, 1);
-
-    // Signal handlers
-    button_playpause->signal_toggled().connect([this, cue, button_playpause]() {
-        if (!cue->gst_pipeline)
-            return;
-
-        if (button_playpause->get_active()) {
-            gst_element_set_state(cue->gst_pipeline, GST_STATE_PAUSED);
-            button_playpause->set_image_from_icon_name("media-playback-start");
-        } else {
-            gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
-            button_playpause->set_image_from_icon_name("media-playback-pause");
-        }
-    });
-
-    button_stop->signal_clicked().connect([this]() {
-        playback_window->stop_playback();  // This seems like a misnamed method
-        
-    });
-
-    button_vol_down->signal_clicked().connect([cue]() {
-        Glib::signal_timeout().connect([cue]() -> bool {
-            gdouble vol = 1.0;
-            g_object_get(cue->gst_pipeline, "volume", &vol, nullptr);
-            vol = std::max(0.0, vol - 0.05);
-            g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-            return vol > 0.0;
-        }, 100);
-    });
-
-    button_vol_up->signal_clicked().connect([cue]() {
-        Glib::signal_timeout().connect([cue]() -> bool {
-            gdouble vol = 0.0;
-            g_object_get(cue->gst_pipeline, "volume", &vol, nullptr);
-            vol = std::min(1.0, vol + 0.05);
-            g_object_set(cue->gst_pipeline, "volume", vol, nullptr);
-            return vol < 1.0;
-        }, 100);
-    });
-
-    button_remove->signal_clicked().connect([this, cue]() {
-        remove_cue(cue);
-    });
-
-    control_box->show_all();
-    per_cue_controls_box.pack_start(*control_box, Gtk::PACK_SHRINK);
-    cue_control_boxes[cue] = control_box;
-
-    // Add to model
-    auto row = *(cue_store->append());
-    row[cue_columns.name] = cue->name;
-    row[cue_columns.prewait] = Glib::ustring::format(res.prewait_seconds / 60, ":", res.prewait_seconds % 60);
-    row[cue_columns.action_text] = get_media_duration_hms(cue->path_or_command);
-    row[cue_columns.action_progress] = 0;
-    row[cue_columns.postwait] = Glib::ustring::format(res.postwait_seconds / 60, ":", res.postwait_seconds % 60);
+    cue->fade_ms = res.fade_ms;
+    cue->fade_target = res.fade_target;
+    cue->fade_curve = res.fade_curve;
+    cue_list.push_back(cue);
+    journal_insert(cue);
+    request_media_duration(cue, append_cue_row(cue));
 }
 
 void PlaylistWindow::add_slideshow_cue()
@@ -379,89 +249,12 @@ void PlaylistWindow::add_slideshow_cue()
     );
 
     cue->slideshow_images = res.slideshow_files;
-    cue_items.push_back(cue);
-
-    // Create UI
-    auto control_box = Gtk::make_managed<Gtk::Grid>();
-    auto label = Gtk::make_managed<Gtk::Label>("Slideshow: " + cue->name);
-    auto label_slide = Gtk::make_managed<Gtk::Label>();
-
-    auto current_index = std::make_shared<int>(0);
-    if (!cue->slideshow_images.empty())
-        label_slide->set_text(cue->slideshow_images[*current_index]);
-    else
-        label_slide->set_text("(No slides)");
-
-    // Images
-    auto but_next_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/fwd.png");
-    auto but_play_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/play.png");
-    auto but_pause_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/pause.png");
-    auto but_prev_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/prev.png");
-    auto but_remove_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/close.png");
-
-    // Buttons
-    auto button_next = Gtk::make_managed<Gtk::Button>();
-    auto button_prev = Gtk::make_managed<Gtk::Button>();
-    auto button_playpause = Gtk::make_managed<Gtk::ToggleButton>();
-    auto button_remove = Gtk::make_managed<Gtk::Button>();
-
-    button_next->set_image(*but_next_img);
-    button_prev->set_image(*but_prev_img);
-    button_playpause->set_image(*but_pause_img);
-    button_remove->set_image(*but_remove_img);
-
-    control_box->attach(*label,           0, 0, 4, 1);
-    control_box->attach(*label_slide,     0, 1, 4, 1);
-    control_box->attach(*button_prev,     0, 2, 1, 1);
-    control_box->attach(*button_playpause,1, 2, 1, 1);
-    control_box->attach(*button_next,     2, 2, 1, 1);
-    control_box->attach(*button_remove,   3, 2, 1, 1);
-
-    // Signals
-    button_next->signal_clicked().connect([this, cue, current_index, label_slide]() {
-        (*current_index)++;
-        if (*current_index >= static_cast<int>(cue->slideshow_images.size()))
-            *current_index = 0;
-
-        auto new_file = cue->slideshow_images[*current_index];
-        label_slide->set_text(new_file);
-        playback_window->show_slide_file(new_file);
-    });
-
-    button_prev->signal_clicked().connect([this, cue, current_index, label_slide]() {
-        (*current_index)--;
-        if (*current_index < 0)
-            *current_index = cue->slideshow_images.size() - 1;
-
-        auto new_file = cue->slideshow_images[*current_index];
-        label_slide->set_text(new_file);
-        playback_window->show_slide_file(new_file);
-    });
-
-    button_playpause->signal_toggled().connect([this, button_playpause]() {
-        if (button_playpause->get_active()) {
-            playback_window->slideshow_pause();
-            button_playpause->set_image_from_icon_name("media-playback-start");
-        } else {
-            playback_window->slideshow_resume();
-            button_playpause->set_image_from_icon_name("media-playback-pause");
-        }
-    });
-
-    button_remove->signal_clicked().connect([this, cue]() {
-        remove_cue(cue);
-    });
-
-    control_box->show_all();
-    per_cue_controls_box.pack_start(*control_box, Gtk::PACK_SHRINK);
-    cue_control_boxes[cue] = control_box;
-    // Add to model
-    auto row = *(cue_store->append());
-    row[cue_columns.name] = cue->name;
-    row[cue_columns.prewait] = Glib::ustring::format(cue->prewait / 60, ":", cue->prewait % 60);
-    row[cue_columns.action_text] = "Slideshow";
-    row[cue_columns.action_progress] = 0;
-    row[cue_columns.postwait] = Glib::ustring::format(cue->postwait / 60, ":", cue->postwait % 60);
+    cue->slideshow_interval_seconds = res.slideshow_interval_seconds;
+    cue->slideshow_transition = res.transition;
+    cue->slideshow_transition_ms = res.transition_ms;
+    cue_list.push_back(cue);
+    journal_insert(cue);
+    append_cue_row(cue);
 }
 
 void PlaylistWindow::add_command_cue()
@@ -486,52 +279,180 @@ void PlaylistWindow::add_command_cue()
         res.loop_forever,
         res.last_frame
     );
+    cue->command_timeout = res.command_timeout;
 
-    cue_items.push_back(cue);
-
-    //Create UI
-    auto control_box = Gtk::make_managed<Gtk::Grid>();
-    auto label = Gtk::make_managed<Gtk::Label>("Command: " + cue->name);
-    auto label_command = Gtk::make_managed<Gtk::Label>();
-    
-    auto but_play_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/play.png");
-    auto but_remove_img = Gtk::make_managed<Gtk::Image>(std::string(STAGESHOW_DATA_DIR) + "/images/close.png");
-    auto button_play = Gtk::make_managed<Gtk::Button>();
-    auto button_remove = Gtk::make_managed<Gtk::Button>();
-    button_play->set_image(*but_play_img);
-    button_remove->set_image(*but_remove_img);
-
-    control_box->attach(*label,         0, 0, 4, 1);
-    control_box->attach(*label_command, 0, 1, 4, 1);
-    control_box->attach(*button_play,   0, 2, 1, 1);
-    control_box->attach(*button_remove, 1, 2, 1, 1);
-    //Signals
-    button_play->signal_clicked().connect([this, cue]() {
-        std::system(cue->path_or_command.c_str());    
-    });
-        
-    button_remove->signal_clicked().connect([this, cue]() {
-        remove_cue(cue);
-    });
+    cue_list.push_back(cue);
+    journal_insert(cue);
+    append_cue_row(cue);
+}
 
-    control_box->show_all();
-    per_cue_controls_box.pack_start(*control_box, Gtk::PACK_SHRINK);
-    cue_control_boxes[cue] = control_box;
-    // Add to model
+Gtk::TreeModel::Row PlaylistWindow::append_cue_row(const std::shared_ptr<CueItem>& cue)
+{
     auto row = *(cue_store->append());
     row[cue_columns.name] = cue->name;
     row[cue_columns.prewait] = Glib::ustring::format(cue->prewait / 60, ":", cue->prewait % 60);
-    row[cue_columns.action_text] = "Control";
     row[cue_columns.action_progress] = 0;
     row[cue_columns.postwait] = Glib::ustring::format(cue->postwait / 60, ":", cue->postwait % 60);
+    row[cue_columns.cue_ptr] = cue;
+
+    switch (cue->type) {
+    case CueItem::Type::Slideshow:
+        row[cue_columns.action_text] = "Slideshow";
+        break;
+    case CueItem::Type::Control:
+        row[cue_columns.action_text] = "Control";
+        break;
+    default:
+        if (cue->duration_probed)
+            row[cue_columns.action_text] = format_seconds_to_hhmmss(cue->action_duration);
+        break;
+    }
+    return row;
 }
 
+void PlaylistWindow::clear_show()
+{
+    cue_store->clear();
+    engine.clear();
+    update_cue_panels();
+}
+
+void PlaylistWindow::open_show(const std::string& path)
+{
+    std::vector<std::shared_ptr<CueItem>> cues;
+    std::string error;
+    if (!load_show(path, cues, error)) {
+        Gtk::MessageDialog dialog(*this, "Cannot open show", false, Gtk::MESSAGE_ERROR);
+        dialog.set_secondary_text(error);
+        dialog.run();
+        return;
+    }
+
+    load_cues(cues, path);
+    journal.snapshot(cue_list, show_path);
+}
+
+void PlaylistWindow::load_cues(const std::vector<std::shared_ptr<CueItem>>& cues, const std::string& path)
+{
+    // Rows only: media is probed when a cue stands by, panels when selected.
+    // The view is detached so it does not track thousands of single inserts.
+    cue_treeview.unset_model();
+    clear_show();
+    for (const auto& cue : cues) {
+        cue_list.push_back(cue);
+        append_cue_row(cue);
+    }
+    cue_treeview.set_model(cue_store);
+
+    // Ready for GO on the first cue
+    if (!cue_store->children().empty())
+        cue_treeview.get_selection()->select(cue_store->children().begin());
+
+    show_path = path;
+    if (!path.empty())
+        set_title("Playlist Manager - " + Glib::path_get_basename(path));
+}
+
+void PlaylistWindow::journal_insert(const std::shared_ptr<CueItem>& cue)
+{
+    journal.record_insert(cue_list.index_of(cue->id), *cue);
+    compact_journal();
+    engine.cues_changed();
+}
+
+void PlaylistWindow::compact_journal()
+{
+    // Keeps replay after a crash short
+    if (journal.wants_snapshot())
+        journal.snapshot(cue_list, show_path);
+}
+
+void PlaylistWindow::on_open_show()
+{
+    Gtk::FileChooserDialog chooser(*this, "Open show", Gtk::FILE_CHOOSER_ACTION_OPEN);
+    chooser.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    chooser.add_button("_Open", Gtk::RESPONSE_OK);
+    if (chooser.run() == Gtk::RESPONSE_OK)
+        open_show(chooser.get_filename());
+}
 
-void PlaylistWindow::on_rows_reordered(const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& iter, int* new_order)
+void PlaylistWindow::on_save_show(bool choose_path)
 {
-    std::cout << "Rows reordered!" << std::endl;
-    // Optionally resync the internal std::vector<std::shared_ptr<CueItem>> cues
-    // with the new Gtk::ListStore order
+    std::string path = show_path;
+    if (choose_path || path.empty()) {
+        Gtk::FileChooserDialog chooser(*this, "Save show", Gtk::FILE_CHOOSER_ACTION_SAVE);
+        chooser.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        chooser.add_button("_Save", Gtk::RESPONSE_OK);
+        chooser.set_do_overwrite_confirmation(true);
+        if (chooser.run() != Gtk::RESPONSE_OK)
+            return;
+        path = chooser.get_filename();
+    }
+
+    std::string error;
+    if (!save_show(path, cue_list, error)) {
+        Gtk::MessageDialog dialog(*this, "Cannot save show", false, Gtk::MESSAGE_ERROR);
+        dialog.set_secondary_text(error);
+        dialog.run();
+        return;
+    }
+    show_path = path;
+    journal.record_show_path(path);
+    set_title("Playlist Manager - " + Glib::path_get_basename(path));
+}
+
+
+void PlaylistWindow::on_rows_reordered(const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& /*iter*/, int* new_order)
+{
+    // Only the top level holds cues
+    if (path.empty()) {
+        cue_list.reorder(new_order);
+        journal.snapshot(cue_list, show_path);
+    }
+}
+
+void PlaylistWindow::on_row_inserted(const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& /*iter*/)
+{
+    // add_*_cue lists the cue before appending its row; a row the list does
+    // not know about is the destination half of a drag-and-drop move
+    if (cue_store->children().size() > cue_list.size())
+        drag_insert_position = path[0];
+}
+
+void PlaylistWindow::on_row_deleted(const Gtk::TreeModel::Path& path)
+{
+    if (drag_insert_position < 0)
+        return;
+
+    // Both positions are in the store as it was with the copy inserted
+    int inserted = drag_insert_position;
+    int deleted = path[0];
+    drag_insert_position = -1;
+
+    size_t from = deleted < inserted ? deleted : deleted - 1;
+    size_t to = inserted < deleted ? inserted : inserted - 1;
+    if (auto cue = cue_list.at(from)) {
+        cue_list.move(cue->id, to);
+        journal.record_move(from, to);
+        compact_journal();
+        engine.cues_changed();
+    }
+}
+
+std::shared_ptr<CueItem> PlaylistWindow::cue_at(const Gtk::TreeModel::iterator& iter) const
+{
+    if (!iter)
+        return nullptr;
+    return (*iter)[cue_columns.cue_ptr];
+}
+
+Gtk::TreeModel::iterator PlaylistWindow::row_of(const std::shared_ptr<CueItem>& cue) const
+{
+    // ListStore rows are a GSequence, so nth-child is O(log n) too
+    int index = cue ? cue_list.index_of(cue->id) : -1;
+    if (index < 0)
+        return Gtk::TreeModel::iterator();
+    return cue_store->children()[index];
 }
 
 void PlaylistWindow::on_go_clicked()
@@ -541,11 +462,10 @@ void PlaylistWindow::on_go_clicked()
     if (!selected_iter)
         return;
 
-    int row_index = std::distance(cue_store->children().begin(), selected_iter);
-
-    if (row_index >= 0 && row_index < static_cast<int>(cue_items.size()))
+    if (auto cue = cue_at(selected_iter))
     {
-        active_cue = cue_items[row_index];
+        // Started before the selection moves, so its standby pipeline is kept
+        engine.go(cue);
 
         // highlight next
         auto next_iter = selected_iter;
@@ -555,252 +475,298 @@ void PlaylistWindow::on_go_clicked()
             selection->select(next_iter);
             cue_treeview.scroll_to_row(cue_store->get_path(next_iter));
         }
-
-        if (active_cue->type == CueItem::Type::Audio)
-        {
-            start_audio_cue(active_cue);
-        }
-        else if (active_cue->type == CueItem::Type::Video)
-        {
-            start_video_cue(active_cue);
-        }
-        else if (active_cue->type == CueItem::Type::Slideshow)
-        {
-            playback_window->start_slideshow(active_cue->slideshow_images, active_cue->slideshow_interval_seconds);
-        	start_slideshow_cue(active_cue);
-        }
-        else if (active_cue->type == CueItem::Type::Control)
-        {
-            start_video_cue(active_cue);
-        }
     }
 }
 
-void PlaylistWindow::set_active_cue(std::shared_ptr<CueItem> cue) {
-    active_cue = cue;
+CuePanel::Actions PlaylistWindow::panel_actions()
+{
+    CuePanel::Actions actions;
+    actions.pause = [this](std::shared_ptr<CueItem> cue, bool paused) {
+        engine.pause(cue, paused);
+    };
+    actions.stop = [this](std::shared_ptr<CueItem> cue) {
+        engine.stop(cue);
+    };
+    actions.remove = [this](std::shared_ptr<CueItem> cue) {
+        // Not from inside the panel's own click handler: removing may free it
+        Glib::signal_idle().connect_once([this, cue]() { remove_cue(cue); });
+    };
+    actions.fade = [this](std::shared_ptr<CueItem> cue, bool up) {
+        engine.fade(cue, up ? 1.0 : cue->fade_target);
+    };
+    actions.slide = [this](std::shared_ptr<CueItem> cue, int step) {
+        engine.step_slide(cue, step);
+    };
+    actions.run = [this](std::shared_ptr<CueItem> cue) {
+        engine.run_command(cue, false);
+    };
+    return actions;
 }
 
-void PlaylistWindow::start_slideshow_cue(std::shared_ptr<CueItem> cue)
+CueEngine::Output PlaylistWindow::engine_output()
 {
-    if (!cue || cue->slideshow_images.empty())
-        return;
-
-    auto it = cue_control_boxes.find(cue);
-    if (it != cue_control_boxes.end()) {
-        auto name = "cue_" + std::to_string(reinterpret_cast<uintptr_t>(cue.get()));
-        cue_controls_stack.set_visible_child(name);
-    }
-
-    auto first_image = cue->slideshow_images.front();
-
-    if (cue->prewait > 0) {
-        Glib::signal_timeout().connect_once(
-            [this, first_image]() {
-                playback_window->show_slide_file(first_image);
-            },
-            cue->prewait * 1000
-        );
-    } else {
-        playback_window->show_slide_file(first_image);
-    }
+    CueEngine::Output output;
+    output.create_video_sink = [this](int& layer) {
+        return playback_window->create_video_sink(layer);
+    };
+    output.show_video_layer = [this](int layer) {
+        playback_window->show_video_layer(layer);
+    };
+    output.release_video_layer = [this](int layer) {
+        playback_window->release_video_layer(layer);
+    };
+    output.hold_video_layer = [this](int layer) {
+        return playback_window->hold_video_layer(layer);
+    };
+    output.show_fallback = [this]() {
+        playback_window->set_fallback_image(fallback_image_path);
+    };
+    output.start_slideshow = [this](std::shared_ptr<CueItem> cue) {
+        playback_window->start_slideshow(cue->slideshow_images, cue->slideshow_interval_seconds,
+                                         cue->slideshow_transition, cue->slideshow_transition_ms);
+    };
+    output.show_slide = [this](const std::string& path) {
+        playback_window->show_slide_file(path);
+    };
+    output.pause_slideshow = [this](bool paused) {
+        if (paused)
+            playback_window->slideshow_pause();
+        else
+            playback_window->slideshow_resume();
+    };
+    return output;
+}
 
-    std::cout << "Started slideshow cue: " << cue->name << "\n";
+CueEngine::Listener PlaylistWindow::engine_listener()
+{
+    CueEngine::Listener listener;
+    listener.state_changed = [this]() {
+        update_cue_panels();
+    };
+    listener.cue_started = [this](std::shared_ptr<CueItem> cue) {
+        // The service follows the row from here on
+        if (auto row = row_of(cue))
+            progress_service->track(cue, cue_store->get_path(row));
+    };
+    listener.cue_stopped = [this](std::shared_ptr<CueItem> cue) {
+        progress_service->untrack(cue);
+    };
+    listener.cue_standby = [this](std::shared_ptr<CueItem> cue) {
+        // Cues loaded from a show file are probed only once they come up
+        if (cue->duration_probed)
+            return;
+        if (auto row = row_of(cue))
+            request_media_duration(cue, *row);
+    };
+    listener.cue_status = [this](std::shared_ptr<CueItem> cue, const std::string& text) {
+        if (auto row = row_of(cue))
+            (*row)[cue_columns.action_text] = text;
+    };
+    listener.slide_changed = [this](std::shared_ptr<CueItem> cue) {
+        update_slide_panel(cue);
+    };
+    return listener;
 }
 
-void PlaylistWindow::start_video_cue(std::shared_ptr<CueItem> cue)
+void PlaylistWindow::update_slide_panel(const std::shared_ptr<CueItem>& cue)
 {
-    if (!cue) return;
+    auto it = cue_panels.find(cue);
+    if (it != cue_panels.end())
+        it->second->update_slide();
+}
 
-    // Show control box
-    auto it = cue_control_boxes.find(cue);
-    if (it != cue_control_boxes.end()) {
-        auto name = "cue_" + std::to_string(reinterpret_cast<uintptr_t>(cue.get()));
-        cue_controls_stack.set_visible_child(name);
+bool PlaylistWindow::on_health_timer()
+{
+    // Only cues with a panel are read; the stats themselves are folded elsewhere
+    for (const auto& entry : cue_panels) {
+        const auto& cue = entry.first;
+        if (engine.is_running(cue))
+            entry.second->update_health(cue->health.describe(cue->type == CueItem::Type::Video));
+        else
+            entry.second->update_health("");
     }
+    return true;
+}
 
-    // Reset pipeline if needed
-    if (cue->gst_pipeline) {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
-        gst_object_unref(cue->gst_pipeline);
+void PlaylistWindow::update_cue_panels()
+{
+    // Panels exist only for the selected, active and running cues
+    std::set<std::shared_ptr<CueItem>> wanted(engine.get_running());
+    if (auto selected = cue_at(cue_treeview.get_selection()->get_selected()))
+        wanted.insert(selected);
+    if (auto active = engine.get_active())
+        wanted.insert(active);
+
+    for (auto it = cue_panels.begin(); it != cue_panels.end();) {
+        if (wanted.count(it->first) && get_cue_index(it->first) >= 0) {
+            ++it;
+            continue;
+        }
+        per_cue_controls_box.remove(*it->second);
+        it->second->unbind();
+        if (idle_panels.size() < max_idle_panels)
+            idle_panels.push_back(std::move(it->second));
+        it = cue_panels.erase(it);
     }
 
-    // Setup pipeline
-    cue->gst_pipeline = gst_element_factory_make("playbin", nullptr);
-    auto gtk_sink = gst_element_factory_make("gtksink", "gtksink");
-    auto audio_sink = gst_element_factory_make("autoaudiosink", "audiosink");
-
-    g_object_set(cue->gst_pipeline,
-                 "video-sink", gtk_sink,
-                 "audio-sink", audio_sink,
-                 nullptr);
-
-    // Extract GtkWidget from gtksink and embed
-    GtkWidget* sink_widget = nullptr;
-    g_object_get(gtk_sink, "widget", &sink_widget, nullptr);
-    if (sink_widget) {
-        auto cpp_widget = Glib::wrap(GTK_WIDGET(sink_widget));
-        playback_window->set_video_container_content(*cpp_widget);
-    } else {
-        std::cerr << "gtksink widget is null!" << std::endl;
-    }
+    for (const auto& cue : wanted) {
+        if (cue_panels.count(cue) || get_cue_index(cue) < 0)
+            continue;
 
-    g_object_set(cue->gst_pipeline, "uri", ("file://" + cue->path_or_command).c_str(), nullptr);
-    g_object_set(cue->gst_pipeline, "volume", 1.0, nullptr);
-
-    // Hook up bus for EOS
-    GstBus* bus = gst_element_get_bus(cue->gst_pipeline);
-    gst_bus_add_signal_watch(bus);
-
-    g_signal_connect(bus, "message", G_CALLBACK(+[](
-        GstBus* bus, GstMessage* msg, gpointer user_data) {
-        if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
-            auto* self = static_cast<PlaylistWindow*>(user_data);
-            Glib::signal_idle().connect_once([self]() {
-//            if(!){            //Check for Static Frame on Playback
-                self->playback_window->set_fallback_image(self->fallback_image_path); // or use a member fallback_slide_path
-//            }
-                self->on_cue_finished();
-            });
+        std::unique_ptr<CuePanel> panel;
+        if (idle_panels.empty()) {
+            panel = std::make_unique<CuePanel>(icons, panel_actions());
+        } else {
+            panel = std::move(idle_panels.back());
+            idle_panels.pop_back();
         }
-    }), this);
-    gst_object_unref(bus);
-
-    // Play with optional delay
-    if (cue->prewait > 0) {
-        Glib::signal_timeout().connect_once(
-            [cue]() {
-                gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
-            },
-            cue->prewait * 1000
-        );
-    } else {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
+        panel->bind(cue, engine.is_paused(cue));
+        per_cue_controls_box.pack_start(*panel, Gtk::PACK_SHRINK);
+        cue_panels[cue] = std::move(panel);
     }
 
-    std::cout << "Started video cue: " << cue->path_or_command << "\n";
-}
+    // Same order as the cue list
+    std::vector<std::pair<int, CuePanel*>> ordered;
+    for (const auto& entry : cue_panels)
+        ordered.emplace_back(get_cue_index(entry.first), entry.second.get());
+    std::sort(ordered.begin(), ordered.end());
+    for (size_t i = 0; i < ordered.size(); ++i)
+        per_cue_controls_box.reorder_child(*ordered[i].second, static_cast<int>(i));
 
-void PlaylistWindow::start_command_cue(std::shared_ptr<CueItem> cue) {
-    if (!cue) return;
-    // Show control box
-    auto it = cue_control_boxes.find(cue);
-    if (it != cue_control_boxes.end()) {
-        auto name = "cue_" + std::to_string(reinterpret_cast<uintptr_t>(cue.get()));
-        cue_controls_stack.set_visible_child(name);
-    }    
-    // Play with optional delay
-    if (cue->prewait > 0) {
-        Glib::signal_timeout().connect_once(
-            [cue]() {
-                std::string command = cue->path_or_command;
-                if (!command.empty()) {
-                    std::cerr << "Running command cue: " << command << std::endl;
-                    std::system(command.c_str());
-                }
-            },
-            cue->prewait * 1000
-        );
-    } else {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
-    }
-    std::cout << "Started command cue: " << cue->path_or_command << "\n";
-    // Trigger cue finished after postwait
-    Glib::signal_timeout().connect_once(
-        sigc::mem_fun(*this, &PlaylistWindow::on_cue_finished),
-        cue->postwait * 1000
-    );
+    publish_cue_state();
 }
 
-
-void PlaylistWindow::start_audio_cue(std::shared_ptr<CueItem> cue)
+void PlaylistWindow::publish_cue_state()
 {
-    if (!cue)
-        return;
-
-    // Show existing controls
-    auto it = cue_control_boxes.find(cue);
-    if (it != cue_control_boxes.end()) {
-        auto name = "cue_" + std::to_string(reinterpret_cast<uintptr_t>(cue.get()));
-        cue_controls_stack.set_visible_child(name);
+    // Panels follow every running/selection change, so events are diffed here
+    auto describe = [this](const std::shared_ptr<CueItem>& cue) {
+        return std::to_string(get_cue_index(cue) + 1) + " " + cue->name;
+    };
+
+    const auto& running_cues = engine.get_running();
+    std::set<uint64_t> running;
+    for (const auto& cue : running_cues)
+        running.insert(cue->id);
+    for (uint64_t id : published_running) {
+        if (!running.count(id)) {
+            auto cue = cue_list.find(id);
+            control_server.notify("STOPPED " + (cue ? describe(cue) : std::string("0 -")));
+        }
     }
-
-    // Clean up old pipeline
-    if (cue->gst_pipeline) {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
-        gst_object_unref(cue->gst_pipeline);
+    for (const auto& cue : running_cues) {
+        if (!published_running.count(cue->id))
+            control_server.notify("RUNNING " + describe(cue));
     }
+    published_running.swap(running);
 
-    // Create pipeline
-    cue->gst_pipeline = gst_element_factory_make("playbin", nullptr);
-    g_object_set(cue->gst_pipeline, "uri", ("file://" + cue->path_or_command).c_str(), nullptr);
-    g_object_set(cue->gst_pipeline, "volume", 1.0, nullptr);
-
-    // Handle prewait
-    if (cue->prewait > 0) {
-        Glib::signal_timeout().connect_once(
-            [cue]() {
-                gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
-            },
-            cue->prewait * 1000
-        );
-    } else {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_PLAYING);
+    auto selected = cue_at(cue_treeview.get_selection()->get_selected());
+    uint64_t standby = selected ? selected->id : 0;
+    if (standby != published_standby) {
+        control_server.notify("STANDBY " + (selected ? describe(selected) : std::string("0 -")));
+        published_standby = standby;
     }
+}
 
-    // Setup bus for EOS
-    GstBus* bus = gst_element_get_bus(cue->gst_pipeline);
-    gst_bus_add_signal_watch(bus);
-
-    g_signal_connect(bus, "message", G_CALLBACK(+[](
-        GstBus* bus, GstMessage* msg, gpointer user_data) {
-        if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
-            auto* self = static_cast<PlaylistWindow*>(user_data);
-            Glib::signal_idle().connect_once([self]() {
-                self->on_cue_finished();
-            });
+std::string PlaylistWindow::on_control_command(const ControlServer::Command& command)
+{
+    // Cues are addressed by their 1-based position in the list
+    std::shared_ptr<CueItem> cue;
+    if (!command.args.empty()) {
+        const std::string& number = command.args.back();
+        gchar* end = nullptr;
+        gint64 index = g_ascii_strtoll(number.c_str(), &end, 10) - 1;
+        bool numeric = end != number.c_str() && *end == '\0';
+        if (numeric) {
+            if (index < 0 || index >= static_cast<gint64>(cue_list.size()))
+                return "ERR no cue " + number;
+            cue = cue_list.at(static_cast<size_t>(index));
+        }
+    }
+    auto number_of = [this](const std::shared_ptr<CueItem>& c) {
+        return c ? std::to_string(get_cue_index(c) + 1) : std::string("-");
+    };
+
+    if (command.verb == "GO") {
+        if (!cue_treeview.get_selection()->get_selected())
+            return "ERR nothing standing by";
+        on_go_clicked();
+        return "OK " + number_of(engine.get_active());
+    }
+    if (command.verb == "STOP") {
+        if (!command.args.empty() && !cue)
+            return "ERR STOP [cue]";
+        if (cue)
+            engine.stop(cue);
+        else
+            engine.stop_all();
+        return "OK";
+    }
+    if (command.verb == "FADE") {
+        std::string direction = command.args.empty() ? "" : command.args.front();
+        std::transform(direction.begin(), direction.end(), direction.begin(),
+                       [](unsigned char c) { return static_cast<char>(g_ascii_toupper(c)); });
+        if (direction != "UP" && direction != "DOWN")
+            return "ERR FADE UP|DOWN [cue]";
+        if (command.args.size() == 1)
+            cue = engine.get_active();
+        if (!cue)
+            return "ERR no active cue";
+        engine.fade(cue, direction == "UP" ? 1.0 : cue->fade_target);
+        return "OK " + number_of(cue);
+    }
+    if (command.verb == "SELECT" || command.verb == "JUMP") {
+        if (!cue)
+            return "ERR " + command.verb + " <cue>";
+        if (auto row = row_of(cue)) {
+            cue_treeview.get_selection()->select(row);
+            cue_treeview.scroll_to_row(cue_store->get_path(row));
         }
-    }), this);
-    gst_object_unref(bus);
+        return "OK " + number_of(cue);
+    }
+    if (command.verb == "TRACE") {
+        // Writes the trace rings as Chrome trace JSON
+        std::string path = command.args.empty() ? trace_default_path() : command.args.front();
+        std::string error;
+        if (!trace_dump(path, error))
+            return "ERR " + error;
+        return "OK " + path;
+    }
+    if (command.verb == "STATUS") {
+        std::string running;
+        for (const auto& c : engine.get_running())
+            running += (running.empty() ? "" : ",") + number_of(c);
+        return "OK standby=" + number_of(cue_at(cue_treeview.get_selection()->get_selected())) +
+               " active=" + number_of(engine.get_active()) +
+               " running=" + (running.empty() ? std::string("-") : running);
+    }
+    return "ERR unknown command " + command.verb;
+}
 
-    std::cout << "Started audio cue: " << cue->path_or_command << "\n";
+void PlaylistWindow::on_selection_changed()
+{
+    auto iter = cue_treeview.get_selection()->get_selected();
+    update_cue_panels();
+    engine.set_standby(cue_at(iter));
 }
 
 void PlaylistWindow::remove_cue(std::shared_ptr<CueItem> cue)
 {
     if (!cue) return;
 
-    if (cue->type == CueItem::Type::Video || cue->type == CueItem::Type::Slideshow) {
-        playback_window->set_fallback_image(fallback_image_path);
-    }
-
     // 1. stop playback if active
-    if (cue->gst_pipeline) {
-        gst_element_set_state(cue->gst_pipeline, GST_STATE_NULL);
-        gst_object_unref(cue->gst_pipeline);
-        cue->gst_pipeline = nullptr;
-    }
-
-    // 2. remove its controls from per_cue_controls_box
-    auto it = cue_control_boxes.find(cue);
-    if (it != cue_control_boxes.end()) {
-        per_cue_controls_box.remove(*it->second);
-        cue_control_boxes.erase(it);
-    }
-
-    // 3. remove from cue_items and model
-    auto iter = std::find(cue_items.begin(), cue_items.end(), cue);
-    if (iter != cue_items.end()) {
-        int index = std::distance(cue_items.begin(), iter);
-        cue_items.erase(iter);
-
-        auto store_iter = cue_store->children().begin();
-        std::advance(store_iter, index);
-        if (store_iter != cue_store->children().end())
-            cue_store->erase(store_iter);
+    engine.remove(cue);
+
+    // 2. remove from the cue list and model
+    if (auto row = row_of(cue)) {
+        journal.record_remove(cue_list.index_of(cue->id));
+        cue_list.remove(cue->id);
+        cue_store->erase(row);
+        compact_journal();
+        engine.cues_changed();
     }
 
-    if (active_cue == cue)
-        active_cue.reset();
+    // 3. its panel goes back to the pool
+    update_cue_panels();
 }
 
 bool PlaylistWindow::on_treeview_key_press(GdkEventKey* event)
@@ -810,12 +776,8 @@ bool PlaylistWindow::on_treeview_key_press(GdkEventKey* event)
         auto selection = cue_treeview.get_selection();
         if (auto iter = selection->get_selected())
         {
-            int index = std::distance(cue_store->children().begin(), iter);
-            if (index >= 0 && index < static_cast<int>(cue_items.size()))
-            {
-                auto cue = cue_items[index];
+            if (auto cue = cue_at(iter))
                 remove_cue(cue);
-            }
         }
         return true;
     }
@@ -824,28 +786,9 @@ bool PlaylistWindow::on_treeview_key_press(GdkEventKey* event)
         auto selection = cue_treeview.get_selection();
         if (auto iter = selection->get_selected())
         {
-            int index = std::distance(cue_store->children().begin(), iter);
-            if (index >= 0 && index < static_cast<int>(cue_items.size()))
+            if (auto cue = cue_at(iter))
             {
-                active_cue = cue_items[index];
-
-                if (active_cue->type == CueItem::Type::Audio)
-                {
-                    start_audio_cue(active_cue);
-                }
-                else if (active_cue->type == CueItem::Type::Video)
-                {
-                    start_video_cue(active_cue);
-                }
-                else if (active_cue->type == CueItem::Type::Slideshow)
-                {
-                    playback_window->start_slideshow(active_cue->slideshow_images, active_cue->slideshow_interval_seconds);
-                    start_slideshow_cue(active_cue);
-                }
-                else if (active_cue->type == CueItem::Type::Control)
-                {
-                    start_command_cue(active_cue);
-                }
+                engine.go(cue);
 
                 // highlight next
                 ++iter;
@@ -866,12 +809,10 @@ void PlaylistWindow::on_row_activated(const Gtk::TreeModel::Path& path, Gtk::Tre
     auto iter = cue_store->get_iter(path);
     if (!iter) return;
 
-    int index = std::distance(cue_store->children().begin(), iter);
-    if (index < 0 || index >= static_cast<int>(cue_items.size()))
+    auto cue = cue_at(iter);
+    if (!cue)
         return;
 
-    auto cue = cue_items[index];
-
     CuePropertiesDialog::CueType type;
     switch (cue->type)
     {
@@ -907,14 +848,23 @@ void PlaylistWindow::on_row_activated(const Gtk::TreeModel::Path& path, Gtk::Tre
 
     dlg.check_immediate.set_active(cue->immediate_next);
     dlg.check_auto_next.set_active(cue->auto_next);
+    dlg.check_loop_forever.set_active(cue->loop_forever);
+    if (type == CuePropertiesDialog::CueType::Audio)
+        dlg.spin_loop_crossfade_ms.set_value(cue->loop_crossfade_ms);
+    if (type == CuePropertiesDialog::CueType::Video)
+        dlg.last_frame.set_active(cue->last_frame);
 
     if (type == CuePropertiesDialog::CueType::Control)
     {
         dlg.command_entry.set_text(cue->path_or_command);
+        dlg.spin_command_timeout.set_value(cue->command_timeout);
     }
     else if (type == CuePropertiesDialog::CueType::Audio || type == CuePropertiesDialog::CueType::Video)
     {
         dlg.file_chooser.set_filename(cue->path_or_command);
+        dlg.spin_fade_ms.set_value(cue->fade_ms);
+        dlg.spin_fade_target.set_value(cue->fade_target * 100.0);
+        dlg.combo_fade_curve.set_active(static_cast<int>(cue->fade_curve));
     }
     else if (type == CuePropertiesDialog::CueType::Slideshow)
     {
@@ -926,13 +876,21 @@ void PlaylistWindow::on_row_activated(const Gtk::TreeModel::Path& path, Gtk::Tre
             row[dlg.slideshow_columns.filepath] = img;
         }
         dlg.spin_slideshow_interval.set_value(cue->slideshow_interval_seconds);
+        dlg.combo_transition.set_active(static_cast<int>(cue->slideshow_transition));
+        dlg.spin_transition_ms.set_value(cue->slideshow_transition_ms);
     }
     if (dlg.run_and_get_result(res))
     {
+        std::string old_path = cue->path_or_command;
         cue->prewait = res.prewait_seconds;
         cue->postwait = res.postwait_seconds;
         cue->immediate_next = res.immediate;
         cue->auto_next = res.auto_next;
+        cue->loop_forever = res.loop_forever;
+        if (cue->type == CueItem::Type::Audio)
+            cue->loop_crossfade_ms = res.loop_crossfade_ms;
+        if (cue->type == CueItem::Type::Video)
+            cue->last_frame = res.last_frame;
         cue->path_or_command = res.file_or_command;
         cue->name = res.name.empty() ? Glib::path_get_basename(res.file_or_command) : res.name;
         // store the first slide as path_or_command for preview in the listview
@@ -941,6 +899,27 @@ void PlaylistWindow::on_row_activated(const Gtk::TreeModel::Path& path, Gtk::Tre
             cue->path_or_command = res.slideshow_files[0];
 
         cue->slideshow_interval_seconds = res.slideshow_interval_seconds;
+        if (cue->type == CueItem::Type::Slideshow) {
+            cue->slideshow_transition = res.transition;
+            cue->slideshow_transition_ms = res.transition_ms;
+        }
+        if (cue->type == CueItem::Type::Control)
+            cue->command_timeout = res.command_timeout;
+        if (cue->type == CueItem::Type::Audio || cue->type == CueItem::Type::Video) {
+            cue->fade_ms = res.fade_ms;
+            cue->fade_target = res.fade_target;
+            cue->fade_curve = res.fade_curve;
+        }
+        // The old file's duration must not be shown or saved for the new one
+        bool media = cue->type == CueItem::Type::Audio || cue->type == CueItem::Type::Video;
+        if (media && cue->path_or_command != old_path) {
+            cue->duration_probed = false;
+            cue->action_duration = 0;
+            request_media_duration(cue, *iter);
+        }
+        journal.record_update(cue_list.index_of(cue->id), *cue);
+        compact_journal();
+        engine.cue_edited(cue);
         (*iter)[cue_columns.name] = cue->name;
         (*iter)[cue_columns.prewait] = Glib::ustring::format(cue->prewait / 60, ":", cue->prewait % 60);
         (*iter)[cue_columns.postwait] = Glib::ustring::format(cue->postwait / 60, ":", cue->postwait % 60);
@@ -959,87 +938,24 @@ bool PlaylistWindow::on_right_click(GdkEventButton* event)
 
 int PlaylistWindow::get_cue_index(const std::shared_ptr<CueItem>& cue) const
 {
-    for (size_t i = 0; i < cue_items.size(); ++i) {
-        if (cue_items[i] == cue)
-            return static_cast<int>(i);
-    }
-    return -1;
-}
-
-void PlaylistWindow::on_cue_finished()
-{
-    if (!active_cue || !active_cue->auto_next)
-        return;
-
-    int current_index = get_cue_index(active_cue);
-    if (current_index < 0 || current_index + 1 >= static_cast<int>(cue_items.size()))
-        return;
-
-    auto next_cue = cue_items[current_index + 1];
-
-	if (!next_cue)
-		return;
-
-    set_active_cue(next_cue); // highlight it in the list
-
-    switch (next_cue->type) {
-		case CueItem::Type::Video:
-            start_video_cue(next_cue);
-            break;
-        case CueItem::Type::Audio:
-            start_audio_cue(next_cue);
-            break;
-        case CueItem::Type::Slideshow:
-          	start_slideshow_cue(next_cue);
-           	break;
-        case CueItem::Type::Control:
-           	start_command_cue(next_cue);
-        	break;
-        default:
-			show_fallback_image();
-            std::cerr << "Unhandled cue type in on_cue_finished()" << std::endl;
-        	break;
-    }
-}
-
-bool PlaylistWindow::on_timeout()
-{
-    for (auto row : cue_store->children())
-    {
-        if (active_cue && row[cue_columns.name] == active_cue->name && active_cue->gst_pipeline)
-        {
-			row[cue_columns.live] = "•";
-            gint64 pos = 0, dur = 0;
-            if (gst_element_query_position(active_cue->gst_pipeline, GST_FORMAT_TIME, &pos) &&
-                gst_element_query_duration(active_cue->gst_pipeline, GST_FORMAT_TIME, &dur))
-            {
-                int pos_sec = pos / GST_SECOND;
-                int dur_sec = dur / GST_SECOND;
-                if (dur_sec > 0)
-                {
-                    int percent = 100 * pos_sec / dur_sec;
-                    row[cue_columns.action_progress] = percent;
-                    int remaining = dur_sec - pos_sec;
-                    row[cue_columns.action_text] = format_seconds_to_hhmmss(remaining);
-                }
-            }
-        }
-    }
-    return true;
+    return cue ? cue_list.index_of(cue->id) : -1;
 }
 
 void PlaylistWindow::on_global_play()
 {
+    auto active_cue = engine.get_active();
     if (active_cue && active_cue->gst_pipeline)
         gst_element_set_state(active_cue->gst_pipeline, GST_STATE_PLAYING);
 }
 void PlaylistWindow::on_global_pause()
 {
+    auto active_cue = engine.get_active();
     if (active_cue && active_cue->gst_pipeline)
         gst_element_set_state(active_cue->gst_pipeline, GST_STATE_PAUSED);
 }
 void PlaylistWindow::on_global_stop()
 {
+    auto active_cue = engine.get_active();
     if (active_cue && active_cue->gst_pipeline)
         gst_element_set_state(active_cue->gst_pipeline, GST_STATE_NULL);
 }
@@ -1074,71 +990,36 @@ GstBusSyncReply PlaylistWindow::bus_sync_handler(GstBus* /*bus*/, GstMessage* me
     return GST_BUS_PASS;
 }
 
-void PlaylistWindow::start_prewait_countdown(std::shared_ptr<CueItem> cue,
-                                             Gtk::TreeModel::Row row,
-                                             std::function<void()> on_complete)
+void PlaylistWindow::on_countdown(const CueScheduler::Countdown& countdown)
 {
-    int* remaining = new int(cue->prewait);
-    row[cue_columns.prewait] = std::to_string(*remaining) + "s";
-
-    Glib::signal_timeout().connect_seconds([remaining, row, this, on_complete]() mutable -> bool {
-        (*remaining)--;
-
-        if (*remaining <= 0) {
-            row[cue_columns.prewait] = "0s";
-            delete remaining;
-            on_complete();  // proceed to cue playback
-            return false;   // stop timeout
-        } else {
-            row[cue_columns.prewait] = std::to_string(*remaining) + "s";
-            return true;    // continue countdown
-        }
-    }, 1);
-}
-
-void PlaylistWindow::start_postwait_countdown(std::shared_ptr<CueItem> cue,
-                                             Gtk::TreeModel::Row row,
-                                             std::function<void()> on_complete)
-{
-    int* remaining = new int(cue->postwait);
-    row[cue_columns.postwait] = std::to_string(*remaining) + "s";
+    auto cue = cue_list.find(countdown.owner);
+    auto row = row_of(cue);
+    if (!row)
+        return;
 
-    Glib::signal_timeout().connect_seconds([remaining, row, this, on_complete]() mutable -> bool {
-        (*remaining)--;
+    bool prewait = countdown.wait == CueScheduler::Wait::Prewait;
+    const auto& column = prewait ? cue_columns.prewait : cue_columns.postwait;
+    int seconds = prewait ? cue->prewait : cue->postwait;
+    if (countdown.done)
+        (*row)[column] = Glib::ustring::format(seconds / 60, ":", seconds % 60);
+    else
+        (*row)[column] = std::to_string(countdown.remaining_seconds) + (countdown.paused ? "s (paused)" : "s");
 
-        if (*remaining <= 0) {
-            row[cue_columns.prewait] = "0s";
-            delete remaining;
-            on_complete();  // proceed to cue playback
-            return false;   // stop timeout
-        } else {
-            row[cue_columns.prewait] = std::to_string(*remaining) + "s";
-            return true;    // continue countdown
-        }
-    }, 1);
+    control_server.notify(std::string(prewait ? "PREWAIT " : "POSTWAIT ") +
+                          std::to_string(get_cue_index(cue) + 1) + " " +
+                          (countdown.done ? std::string("done") :
+                           std::to_string(countdown.remaining_seconds) + (countdown.paused ? " paused" : "")));
 }
 
 void PlaylistWindow::on_global_fadeup()
 {
-    if (active_cue && active_cue->gst_pipeline)
-    {
-        gdouble volume = 1.0;
-        g_object_get(active_cue->gst_pipeline, "volume", &volume, nullptr);
-        volume += 0.1;
-        if (volume > 1.0) volume = 1.0;
-        g_object_set(active_cue->gst_pipeline, "volume", volume, nullptr);
-    }
+    if (auto active_cue = engine.get_active())
+        engine.fade(active_cue, 1.0);
 }
 void PlaylistWindow::on_global_fadedown()
 {
-    if (active_cue && active_cue->gst_pipeline)
-    {
-        gdouble volume = 1.0;
-        g_object_get(active_cue->gst_pipeline, "volume", &volume, nullptr);
-        volume -= 0.1;
-        if (volume < 0.0) volume = 0.0;
-        g_object_set(active_cue->gst_pipeline, "volume", volume, nullptr);
-    }
+    if (auto active_cue = engine.get_active())
+        engine.fade(active_cue, active_cue->fade_target);
 }
 
 void PlaylistWindow::on_gst_message(GstMessage* msg)
@@ -1158,51 +1039,39 @@ std::string PlaylistWindow::get_slideshow_duration_hms(const std::string& filepa
 
 }
 
-std::string PlaylistWindow::get_media_duration_hms(const std::string& filepath) {
-    GstElement* pipeline = gst_element_factory_make("playbin", nullptr);
-    if (!pipeline)
-        return "(Error)";
-
-    std::string uri = "file://" + filepath;
-    g_object_set(pipeline, "uri", uri.c_str(), nullptr);
-
-    gst_element_set_state(pipeline, GST_STATE_PAUSED);
-
-    GstStateChangeReturn ret = gst_element_get_state(pipeline, nullptr, nullptr, 5 * GST_SECOND);
-    if (ret == GST_STATE_CHANGE_FAILURE) {
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(pipeline);
-        return "(Error)";
-    }
-
-    gint64 duration_ns = GST_CLOCK_TIME_NONE;
-    if (!gst_element_query_duration(pipeline, GST_FORMAT_TIME, &duration_ns)) {
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(pipeline);
-        return "(Unknown)";
-    }
-
-    gst_element_set_state(pipeline, GST_STATE_NULL);
-    gst_object_unref(pipeline);
+void PlaylistWindow::request_media_duration(std::shared_ptr<CueItem> cue, const Gtk::TreeModel::Row& row)
+{
+    row[cue_columns.action_text] = "(Probing)";
 
-    int total_seconds = static_cast<int>(duration_ns / GST_SECOND);
-    int h = total_seconds / 3600;
-    int m = (total_seconds % 3600) / 60;
-    int s = total_seconds % 60;
+    // The row may be moved or removed before the probe finishes
+    auto row_ref = std::make_shared<Gtk::TreeRowReference>(cue_store, cue_store->get_path(row));
+    std::weak_ptr<CueItem> weak_cue = cue;
+    std::string path = cue->path_or_command;
 
-    std::ostringstream oss;
-    oss << std::setfill('0') << std::setw(2) << h << ":"
-        << std::setw(2) << m << ":"
-        << std::setw(2) << s;
+    media_prober.probe(path, [this, row_ref, weak_cue, path](const MediaProber::Result& result) {
+        auto cue = weak_cue.lock();
+        // An edit since may have pointed the cue at another file
+        if (!cue || !row_ref->is_valid() || cue->path_or_command != path)
+            return;
 
-    return oss.str();
+        auto row = *cue_store->get_iter(row_ref->get_path());
+        if (!result.ok) {
+            row[cue_columns.action_text] = "(Error)";
+        } else if (!GST_CLOCK_TIME_IS_VALID(result.info.duration)) {
+            row[cue_columns.action_text] = "(Unknown)";
+        } else {
+            int total_seconds = static_cast<int>(result.info.duration / GST_SECOND);
+            cue->action_duration = total_seconds;
+            cue->duration_probed = true;
+            row[cue_columns.action_text] = format_seconds_to_hhmmss(total_seconds);
+        }
+    });
 }
 
 void PlaylistWindow::show_fallback_image()
 {
 	std::cout << "Fallback image" << std::endl; 
-    pw.video_area.hide();         // Or stop drawing video to this area
-    playback_window->show_slide_file(std::string(STAGESHOW_DATA_DIR) + "/images/fallback.png");
+    playback_window->show_fallback();
 }
 
 void PlaylistWindow::on_preferences_clicked()
@@ -1223,6 +1092,26 @@ void PlaylistWindow::on_preferences_clicked()
     box->pack_start(*filename_label, Gtk::PACK_EXPAND_WIDGET);
     box->pack_start(*choose_button, Gtk::PACK_SHRINK);
 
+    auto probe_box = Gtk::make_managed<Gtk::Box>(Gtk::ORIENTATION_HORIZONTAL, 10);
+    auto probe_label = Gtk::make_managed<Gtk::Label>("Media probe threads:");
+    auto probe_spin = Gtk::make_managed<Gtk::SpinButton>();
+    probe_spin->set_range(1, 32);
+    probe_spin->set_increments(1, 4);
+    probe_spin->set_value(media_prober.get_concurrency());
+
+    probe_box->pack_start(*probe_label, Gtk::PACK_SHRINK);
+    probe_box->pack_start(*probe_spin, Gtk::PACK_SHRINK);
+
+    auto progress_box = Gtk::make_managed<Gtk::Box>(Gtk::ORIENTATION_HORIZONTAL, 10);
+    auto progress_label = Gtk::make_managed<Gtk::Label>("Progress updates per second:");
+    auto progress_spin = Gtk::make_managed<Gtk::SpinButton>();
+    progress_spin->set_range(1, 60);
+    progress_spin->set_increments(1, 5);
+    progress_spin->set_value(progress_service->get_rate());
+
+    progress_box->pack_start(*progress_label, Gtk::PACK_SHRINK);
+    progress_box->pack_start(*progress_spin, Gtk::PACK_SHRINK);
+
     choose_button->signal_clicked().connect([this, filename_label]() {
         Gtk::FileChooserDialog chooser("Select fallback image", Gtk::FILE_CHOOSER_ACTION_OPEN);
         chooser.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
@@ -1243,6 +1132,11 @@ void PlaylistWindow::on_preferences_clicked()
     });
 
     content->pack_start(*box);
+    content->pack_start(*probe_box);
+    content->pack_start(*progress_box);
     dialog.show_all();
-    dialog.run();
+    if (dialog.run() == Gtk::RESPONSE_OK) {
+        media_prober.set_concurrency(probe_spin->get_value_as_int());
+        progress_service->set_rate(progress_spin->get_value_as_int());
+    }
 }
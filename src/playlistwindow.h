@@ -4,14 +4,23 @@
 #include <gst/gst.h>
 #include <gst/video/videooverlay.h>
 #include <memory>
+#include <set>
 #include "cueitem.h"
+#include "cuelist.h"
+#include "cuepanel.h"
+#include "editjournal.h"
+#include "iconcache.h"
 #include "playbackwindow.h"
 #include "cuepropertiesdialog.h"
+#include "mediaprober.h"
+#include "controlserver.h"
+#include "cueengine.h"
+#include "progressservice.h"
 
 class PlaylistWindow : public Gtk::Window
 {
 public:
-    explicit PlaylistWindow(std::shared_ptr<PlaybackWindow> playback_win);
+    PlaylistWindow(std::shared_ptr<PlaybackWindow> playback_win, std::shared_ptr<CueScheduler> scheduler);
     ~PlaylistWindow();
 
 protected:
@@ -37,14 +46,16 @@ protected:
         Gtk::TreeModelColumn<Glib::ustring> postwait;
 		Gtk::TreeModelColumn<std::shared_ptr<CueItem>> cue_ptr;
     };
-	PlaybackWindow pw;
-
     CueColumns cue_columns;
     Glib::RefPtr<Gtk::ListStore> cue_store;
 
-    std::vector<std::shared_ptr<CueItem>> cue_items;
-    std::shared_ptr<CueItem> active_cue;
     std::shared_ptr<PlaybackWindow> playback_window;
+    std::shared_ptr<CueScheduler> scheduler;
+    // cues, pipelines and playback state; this window is a view over it
+    CueEngine engine;
+    // authoritative cue order, owned by the engine; rows carry cue_ptr and follow it
+    CueList& cue_list;
+    int drag_insert_position = -1;
 
     // layout
     Gtk::Box vbox {Gtk::ORIENTATION_VERTICAL};
@@ -61,9 +72,14 @@ protected:
     // right
     Gtk::Grid global_control_grid;
     Gtk::Separator sep1;
-    Gtk::Stack cue_controls_stack;
-	std::map<std::shared_ptr<CueItem>, Gtk::Widget*> cue_control_boxes;
 	Gtk::Box per_cue_controls_box {Gtk::ORIENTATION_VERTICAL};
+    // panels for the selected and running cues; the rest are pooled
+    static constexpr size_t max_idle_panels = 4;
+    IconCache icons;
+    std::map<std::shared_ptr<CueItem>, std::unique_ptr<CuePanel>> cue_panels;
+    std::vector<std::unique_ptr<CuePanel>> idle_panels;
+    // refreshes the health line of running cues' panels
+    sigc::connection health_timer;
 
     // global controls
     Gtk::Button button_global_play {"Play"};
@@ -82,16 +98,28 @@ protected:
 
     GstElement* gtk_sink = nullptr; // class member
 
+    MediaProber media_prober;
+    ControlServer control_server;
+    // last state pushed to control subscribers
+    std::set<uint64_t> published_running;
+    uint64_t published_standby = 0;
+    std::unique_ptr<ProgressService> progress_service; // needs cue_store
+
 	std::string fallback_image_path;
+    std::string show_path;
+    EditJournal journal;
     // handlers
 	void on_preferences_clicked();
 
     void on_go_clicked();
     void on_row_activated(const Gtk::TreeModel::Path&, Gtk::TreeViewColumn*);
 	void on_rows_reordered(const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& iter, int* new_order);
+    void on_row_inserted(const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& iter);
+    void on_row_deleted(const Gtk::TreeModel::Path& path);
+    std::shared_ptr<CueItem> cue_at(const Gtk::TreeModel::iterator& iter) const;
+    Gtk::TreeModel::iterator row_of(const std::shared_ptr<CueItem>& cue) const;
     bool on_right_click(GdkEventButton*);
     bool on_treeview_key_press(GdkEventKey*);
-    bool on_timeout();
 
     void on_global_play();
     void on_global_pause();
@@ -99,25 +127,41 @@ protected:
     void on_global_fadeup();
     void on_global_fadedown();
 
+    // remote control
+    std::string on_control_command(const ControlServer::Command& command);
+    void publish_cue_state();
+
     void add_audio_cue();
     void add_video_cue();
     void add_slideshow_cue();
     void add_command_cue();
     void remove_cue(std::shared_ptr<CueItem> cue);
+    Gtk::TreeModel::Row append_cue_row(const std::shared_ptr<CueItem>& cue);
+
+    // show files
+    void clear_show();
+    void open_show(const std::string& path);
+    void load_cues(const std::vector<std::shared_ptr<CueItem>>& cues, const std::string& path);
+    void journal_insert(const std::shared_ptr<CueItem>& cue);
+    void compact_journal();
+    void on_open_show();
+    void on_save_show(bool choose_path);
     
     static GstBusSyncReply bus_sync_handler(GstBus* bus, GstMessage* message, gpointer user_data);
-	void on_cue_finished();
 	int get_cue_index(const std::shared_ptr<CueItem>& cue) const;
-    void set_active_cue(std::shared_ptr<CueItem>);
-	std::string get_media_duration_hms(const std::string& filepath);
+    CuePanel::Actions panel_actions();
+    CueEngine::Output engine_output();
+    CueEngine::Listener engine_listener();
+    void update_cue_panels();
+	void request_media_duration(std::shared_ptr<CueItem> cue, const Gtk::TreeModel::Row& row);
 	std::string get_slideshow_duration_hms(const std::string& filepath, int seconds);
 	void on_gst_message(GstMessage* msg);
 	void show_fallback_image();
-	void start_prewait_countdown(std::shared_ptr<CueItem> cue, Gtk::TreeModel::Row row, std::function<void()> on_complete);
-	void start_postwait_countdown(std::shared_ptr<CueItem> cue, Gtk::TreeModel::Row row, std::function<void()> on_complete);
-	void start_slideshow_cue(std::shared_ptr<CueItem> cue);
-	void start_video_cue(std::shared_ptr<CueItem> cue);
-    void start_audio_cue(std::shared_ptr<CueItem> cue);
-    void start_command_cue(std::shared_ptr<CueItem>);
+	void on_countdown(const CueScheduler::Countdown& countdown);
+    void update_slide_panel(const std::shared_ptr<CueItem>& cue);
+    bool on_health_timer();
+
+    // standby: the selected (next) cue is pre-rolled by the engine
+    void on_selection_changed();
 };
 
@@ -0,0 +1,111 @@
+#include "progressservice.h"
+#include "utils.h"
+#include <algorithm>
+
+ProgressService::ProgressService(Gtk::Widget& clock_widget, Glib::RefPtr<Gtk::ListStore> store,
+                                 const Columns& columns, unsigned rate_hz)
+: clock_widget(clock_widget),
+  store(store),
+  columns(columns),
+  rate_hz(std::max(1u, rate_hz))
+{
+}
+
+ProgressService::~ProgressService()
+{
+    if (tick_id)
+        clock_widget.remove_tick_callback(tick_id);
+}
+
+void ProgressService::track(const std::shared_ptr<CueItem>& cue, const Gtk::TreeModel::Path& path)
+{
+    untrack(cue);
+
+    Entry entry;
+    entry.cue = cue;
+    entry.row = Gtk::TreeRowReference(store, path);
+    if (auto iter = store->get_iter(path))
+        (*iter)[columns.live] = "•";
+    entries.push_back(std::move(entry));
+
+    if (!tick_id) {
+        next_update_us = 0;
+        tick_id = clock_widget.add_tick_callback(sigc::mem_fun(*this, &ProgressService::on_tick));
+    }
+}
+
+void ProgressService::untrack(const std::shared_ptr<CueItem>& cue)
+{
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->cue.lock() == cue) {
+            clear_live(*it);
+            entries.erase(it);
+            return;
+        }
+    }
+}
+
+void ProgressService::set_rate(unsigned hz)
+{
+    rate_hz = std::max(1u, hz);
+    next_update_us = 0;
+}
+
+void ProgressService::clear_live(Entry& entry)
+{
+    if (!entry.row.is_valid())
+        return;
+    if (auto iter = store->get_iter(entry.row.get_path()))
+        (*iter)[columns.live] = "";
+}
+
+bool ProgressService::on_tick(const Glib::RefPtr<Gdk::FrameClock>& clock)
+{
+    // Drop cues that were removed or whose rows went away
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& entry) {
+                      return entry.cue.expired() || !entry.row.is_valid();
+                  }),
+                  entries.end());
+    if (entries.empty()) {
+        tick_id = 0;
+        return false;
+    }
+
+    gint64 now = clock->get_frame_time();
+    if (now < next_update_us)
+        return true;
+    next_update_us = now + 1000000 / rate_hz;
+
+    for (auto& entry : entries)
+        update(entry);
+    return true;
+}
+
+void ProgressService::update(Entry& entry)
+{
+    auto cue = entry.cue.lock();
+    if (!cue || !cue->gst_pipeline)
+        return;
+
+    gint64 pos = 0, dur = 0;
+    if (!gst_element_query_position(cue->gst_pipeline, GST_FORMAT_TIME, &pos) ||
+        !gst_element_query_duration(cue->gst_pipeline, GST_FORMAT_TIME, &dur) || dur <= 0)
+        return;
+
+    pos = std::min(std::max<gint64>(pos, 0), dur);
+    int percent = static_cast<int>(100 * pos / dur);
+    // Round up, so the display reaches 0 exactly as the cue ends
+    int remaining = static_cast<int>((dur - pos + GST_SECOND - 1) / GST_SECOND);
+    if (percent == entry.percent && remaining == entry.remaining_seconds)
+        return;
+
+    auto iter = store->get_iter(entry.row.get_path());
+    if (!iter)
+        return;
+    if (percent != entry.percent)
+        (*iter)[columns.progress] = percent;
+    if (remaining != entry.remaining_seconds)
+        (*iter)[columns.text] = format_seconds_to_hhmmss(remaining);
+    entry.percent = percent;
+    entry.remaining_seconds = remaining;
+}
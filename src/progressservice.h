@@ -0,0 +1,58 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <memory>
+#include <vector>
+#include "cueitem.h"
+
+// Keeps the progress columns of running cues up to date. Only cues handed to
+// track() are polled, each through a TreeRowReference taken when it started,
+// so the cost follows the number of running cues rather than the list size
+// and reordering rows does not confuse it.
+//
+// Updates ride the frame clock of `clock_widget`, throttled to `rate_hz`, and
+// only run while something is tracked. A row is written only when the value
+// it displays would change.
+class ProgressService
+{
+public:
+    struct Columns {
+        const Gtk::TreeModelColumn<Glib::ustring>& live;
+        const Gtk::TreeModelColumn<int>& progress;
+        const Gtk::TreeModelColumn<Glib::ustring>& text;
+    };
+
+    ProgressService(Gtk::Widget& clock_widget, Glib::RefPtr<Gtk::ListStore> store,
+                    const Columns& columns, unsigned rate_hz = 10);
+    ~ProgressService();
+
+    ProgressService(const ProgressService&) = delete;
+    ProgressService& operator=(const ProgressService&) = delete;
+
+    void track(const std::shared_ptr<CueItem>& cue, const Gtk::TreeModel::Path& path);
+    void untrack(const std::shared_ptr<CueItem>& cue);
+
+    void set_rate(unsigned hz);
+    unsigned get_rate() const { return rate_hz; }
+
+private:
+    struct Entry {
+        std::weak_ptr<CueItem> cue;
+        Gtk::TreeRowReference row;
+        int percent = -1;
+        int remaining_seconds = -1;
+    };
+
+    bool on_tick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+    void update(Entry& entry);
+    void clear_live(Entry& entry);
+
+    Gtk::Widget& clock_widget;
+    Glib::RefPtr<Gtk::ListStore> store;
+    Columns columns;
+    unsigned rate_hz;
+
+    std::vector<Entry> entries;
+    guint tick_id = 0;
+    gint64 next_update_us = 0;
+};
@@ -0,0 +1,259 @@
+#include "showfile.h"
+#include <glib.h>
+#include <cstring>
+#include <fstream>
+
+const int show_file_version = 1;
+
+namespace {
+const char* const header = "stageshow-show";
+
+const char* type_name(CueItem::Type type)
+{
+    switch (type) {
+        case CueItem::Type::Audio: return "audio";
+        case CueItem::Type::Video: return "video";
+        case CueItem::Type::Slideshow: return "slideshow";
+        case CueItem::Type::Control: return "control";
+    }
+    return "audio";
+}
+
+bool parse_type(const std::string& name, CueItem::Type& type)
+{
+    for (auto candidate : {CueItem::Type::Audio, CueItem::Type::Video,
+                           CueItem::Type::Slideshow, CueItem::Type::Control}) {
+        if (name == type_name(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void append_escaped(std::string& out, const std::string& value)
+{
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            default: out += c; break;
+        }
+    }
+}
+
+std::string unescape(const char* begin, const char* end)
+{
+    std::string out;
+    out.reserve(end - begin);
+    for (const char* p = begin; p < end; ++p) {
+        if (*p != '\\' || p + 1 == end) {
+            out += *p;
+            continue;
+        }
+        switch (*++p) {
+            case 't': out += '\t'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            default: out += *p; break;
+        }
+    }
+    return out;
+}
+
+void field(std::string& out, const char* key, const std::string& value)
+{
+    if (!out.empty())
+        out += '\t';
+    out += key;
+    out += '=';
+    append_escaped(out, value);
+}
+
+void field(std::string& out, const char* key, long long value)
+{
+    field(out, key, std::to_string(value));
+}
+
+void field(std::string& out, const char* key, double value)
+{
+    // Locale-independent, so show files move between machines
+    char buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    field(out, key, std::string(g_ascii_dtostr(buffer, sizeof(buffer), value)));
+}
+
+int to_int(const std::string& value)
+{
+    return static_cast<int>(g_ascii_strtoll(value.c_str(), nullptr, 10));
+}
+}
+
+std::string escape_field(const std::string& value)
+{
+    std::string out;
+    append_escaped(out, value);
+    return out;
+}
+
+std::string unescape_field(const std::string& value)
+{
+    return unescape(value.data(), value.data() + value.size());
+}
+
+std::string encode_cue(const CueItem& cue)
+{
+    std::string out;
+    field(out, "type", std::string(type_name(cue.type)));
+    field(out, "name", cue.name);
+    field(out, "path", cue.path_or_command);
+    field(out, "prewait", static_cast<long long>(cue.prewait));
+    field(out, "postwait", static_cast<long long>(cue.postwait));
+    if (cue.duration_probed)
+        field(out, "duration", static_cast<long long>(cue.action_duration));
+    field(out, "auto_next", static_cast<long long>(cue.auto_next));
+    field(out, "immediate", static_cast<long long>(cue.immediate_next));
+    field(out, "loop", static_cast<long long>(cue.loop_forever));
+    if (cue.type == CueItem::Type::Audio)
+        field(out, "loop_xfade_ms", static_cast<long long>(cue.loop_crossfade_ms));
+    field(out, "last_frame", static_cast<long long>(cue.last_frame));
+    field(out, "fade_ms", static_cast<long long>(cue.fade_ms));
+    field(out, "fade_target", cue.fade_target);
+    field(out, "fade_curve", static_cast<long long>(cue.fade_curve));
+    if (cue.type == CueItem::Type::Control)
+        field(out, "timeout", static_cast<long long>(cue.command_timeout));
+    if (cue.type == CueItem::Type::Slideshow) {
+        field(out, "interval", static_cast<long long>(cue.slideshow_interval_seconds));
+        field(out, "transition", static_cast<long long>(cue.slideshow_transition));
+        field(out, "transition_ms", static_cast<long long>(cue.slideshow_transition_ms));
+        for (const auto& image : cue.slideshow_images)
+            field(out, "image", image);
+    }
+    return out;
+}
+
+std::shared_ptr<CueItem> decode_cue(const std::string& line, std::string& error)
+{
+    auto cue = std::make_shared<CueItem>(CueItem::Type::Audio, "", "", 0, 0, 0,
+                                         false, false, false, false);
+    bool have_type = false;
+
+    const char* p = line.c_str();
+    const char* end = p + line.size();
+    while (p < end) {
+        const char* tab = static_cast<const char*>(memchr(p, '\t', end - p));
+        const char* field_end = tab ? tab : end;
+        const char* eq = static_cast<const char*>(memchr(p, '=', field_end - p));
+        if (eq) {
+            std::string key(p, eq);
+            std::string value = unescape(eq + 1, field_end);
+
+            if (key == "type") {
+                have_type = parse_type(value, cue->type);
+            } else if (key == "name") {
+                cue->name = value;
+            } else if (key == "path") {
+                cue->path_or_command = value;
+            } else if (key == "prewait") {
+                cue->prewait = to_int(value);
+            } else if (key == "postwait") {
+                cue->postwait = to_int(value);
+            } else if (key == "duration") {
+                cue->action_duration = to_int(value);
+                cue->duration_probed = true;
+            } else if (key == "auto_next") {
+                cue->auto_next = to_int(value) != 0;
+            } else if (key == "immediate") {
+                cue->immediate_next = to_int(value) != 0;
+            } else if (key == "loop") {
+                cue->loop_forever = to_int(value) != 0;
+            } else if (key == "loop_xfade_ms") {
+                cue->loop_crossfade_ms = to_int(value);
+            } else if (key == "last_frame") {
+                cue->last_frame = to_int(value) != 0;
+            } else if (key == "fade_ms") {
+                cue->fade_ms = to_int(value);
+            } else if (key == "fade_target") {
+                cue->fade_target = g_ascii_strtod(value.c_str(), nullptr);
+            } else if (key == "fade_curve") {
+                cue->fade_curve = static_cast<FadeCurve>(to_int(value));
+            } else if (key == "timeout") {
+                cue->command_timeout = to_int(value);
+            } else if (key == "interval") {
+                cue->slideshow_interval_seconds = to_int(value);
+            } else if (key == "transition") {
+                cue->slideshow_transition = static_cast<TransitionType>(to_int(value));
+            } else if (key == "transition_ms") {
+                cue->slideshow_transition_ms = to_int(value);
+            } else if (key == "image") {
+                cue->slideshow_images.push_back(std::move(value));
+            }
+        }
+        p = field_end + 1;
+    }
+
+    if (!have_type) {
+        error = "cue without a valid type";
+        return nullptr;
+    }
+    return cue;
+}
+
+std::string encode_show(const CueList& cues)
+{
+    std::string contents = std::string(header) + " " + std::to_string(show_file_version) + "\n";
+    cues.for_each([&contents](const std::shared_ptr<CueItem>& cue) {
+        contents += encode_cue(*cue);
+        contents += '\n';
+    });
+    return contents;
+}
+
+bool save_show(const std::string& path, const CueList& cues, std::string& error)
+{
+    std::string contents = encode_show(cues);
+
+    // Written beside `path` and renamed over it, so a crash leaves the old file
+    GError* err = nullptr;
+    if (!g_file_set_contents(path.c_str(), contents.data(), static_cast<gssize>(contents.size()), &err)) {
+        error = err ? err->message : "cannot write show file";
+        g_clear_error(&err);
+        return false;
+    }
+    return true;
+}
+
+bool load_show(const std::string& path, std::vector<std::shared_ptr<CueItem>>& cues, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(in, line) || line.compare(0, strlen(header), header) != 0) {
+        error = path + " is not a show file";
+        return false;
+    }
+    int version = to_int(line.substr(strlen(header)));
+    if (version < 1 || version > show_file_version) {
+        error = path + ": unsupported show file version " + std::to_string(version);
+        return false;
+    }
+
+    int line_number = 1;
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (line.empty())
+            continue;
+        auto cue = decode_cue(line, error);
+        if (!cue) {
+            error = path + ":" + std::to_string(line_number) + ": " + error;
+            return false;
+        }
+        cues.push_back(std::move(cue));
+    }
+    return true;
+}
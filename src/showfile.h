@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "cueitem.h"
+#include "cuelist.h"
+
+// Show files: a version line, then one line per cue in list order.
+//
+//     stageshow-show 1
+//     type=audio<TAB>name=Intro<TAB>path=/media/intro.wav<TAB>prewait=0 ...
+//
+// Each cue line is a set of key=value fields separated by tabs, with tab,
+// newline, carriage return and backslash escaped in values. Unknown keys are
+// skipped and missing keys keep the CueItem defaults, so fields can be added
+// without bumping the version. Repeated keys (image=) form lists.
+//
+// Nothing here touches media files or widgets; loading only parses text.
+
+extern const int show_file_version;
+
+// Backslash escapes for tab, newline and carriage return
+std::string escape_field(const std::string& value);
+std::string unescape_field(const std::string& value);
+
+std::string encode_cue(const CueItem& cue);
+// Null (with `error` set) if the line is not a valid cue
+std::shared_ptr<CueItem> decode_cue(const std::string& line, std::string& error);
+
+// The whole file, header included
+std::string encode_show(const CueList& cues);
+// Written to a temporary file and renamed over `path`
+bool save_show(const std::string& path, const CueList& cues, std::string& error);
+bool load_show(const std::string& path, std::vector<std::shared_ptr<CueItem>>& cues, std::string& error);
@@ -0,0 +1,243 @@
+#include "slidedecoder.h"
+#include "trace.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+size_t pixbuf_bytes(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+{
+    return static_cast<size_t>(pixbuf->get_rowstride()) * pixbuf->get_height();
+}
+}
+
+SlideDecoder::SlideDecoder(unsigned threads, int lookahead, size_t memory_cap)
+: lookahead(lookahead),
+  memory_cap(memory_cap)
+{
+    dispatcher.connect(sigc::mem_fun(*this, &SlideDecoder::on_dispatch));
+    for (unsigned i = 0; i < std::max(1u, threads); ++i)
+        workers.emplace_back(&SlideDecoder::worker_main, this);
+}
+
+SlideDecoder::~SlideDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    cond.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void SlideDecoder::set_files(const std::vector<std::string>& new_files)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        jobs.clear();
+        done.clear();
+    }
+    files = new_files;
+    position = 0;
+    decoded.clear();
+    pending.clear();
+    memory_used = 0;
+}
+
+void SlideDecoder::set_max_size(int width, int height)
+{
+    if (width == max_width && height == max_height)
+        return;
+
+    max_width = width;
+    max_height = height;
+    // Slides decoded for the old bound are still usable; only new jobs change
+}
+
+void SlideDecoder::set_output_size(int width, int height)
+{
+    if (width == output_width && height == output_height)
+        return;
+
+    output_width = width;
+    output_height = height;
+    set_position(position);
+}
+
+bool SlideDecoder::at_output_size(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) const
+{
+    return output_width <= 0 || output_height <= 0
+        || (pixbuf->get_width() == output_width && pixbuf->get_height() == output_height);
+}
+
+Glib::RefPtr<Gdk::Pixbuf> SlideDecoder::get(int index) const
+{
+    auto it = decoded.find(index);
+    if (it == decoded.end())
+        return Glib::RefPtr<Gdk::Pixbuf>();
+    return it->second;
+}
+
+std::vector<int> SlideDecoder::ring_indices() const
+{
+    // Current slide first, then alternate outwards: +1, -1, +2, -2, ...
+    std::vector<int> ring;
+    int count = static_cast<int>(files.size());
+    if (count == 0)
+        return ring;
+
+    auto add = [&](int index) {
+        index = ((index % count) + count) % count;
+        if (std::find(ring.begin(), ring.end(), index) == ring.end())
+            ring.push_back(index);
+    };
+    add(position);
+    for (int step = 1; step <= lookahead; ++step) {
+        add(position + step);
+        add(position - step);
+    }
+    return ring;
+}
+
+int SlideDecoder::ring_distance(int index) const
+{
+    int count = static_cast<int>(files.size());
+    int forward = ((index - position) % count + count) % count;
+    return std::min(forward, count - forward);
+}
+
+void SlideDecoder::set_position(int index)
+{
+    if (files.empty())
+        return;
+
+    position = index;
+    auto ring = ring_indices();
+
+    // Drop decoded slides that fell out of the ring
+    for (auto it = decoded.begin(); it != decoded.end();) {
+        if (std::find(ring.begin(), ring.end(), it->first) == ring.end()) {
+            memory_used -= pixbuf_bytes(it->second);
+            it = decoded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Re-prioritise: queued but not yet started jobs are replaced
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& job : jobs)
+            pending.erase(job.index);
+        jobs.clear();
+
+        for (int slide : ring) {
+            auto it = decoded.find(slide);
+            if (pending.count(slide) || (it != decoded.end() && at_output_size(it->second)))
+                continue;
+            jobs.push_back({generation, slide, files[slide], max_width, max_height, output_width, output_height});
+            pending.insert(slide);
+        }
+    }
+    cond.notify_all();
+}
+
+void SlideDecoder::trim_to_cap()
+{
+    // Evict the slide farthest from the current position, never the current one
+    while (memory_used > memory_cap && decoded.size() > 1) {
+        auto farthest = decoded.end();
+        for (auto it = decoded.begin(); it != decoded.end(); ++it) {
+            if (it->first == position)
+                continue;
+            if (farthest == decoded.end() || ring_distance(it->first) > ring_distance(farthest->first))
+                farthest = it;
+        }
+        if (farthest == decoded.end())
+            break;
+        memory_used -= pixbuf_bytes(farthest->second);
+        decoded.erase(farthest);
+    }
+}
+
+void SlideDecoder::worker_main()
+{
+    trace_set_thread_name("slide decoder");
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                break;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+        TraceSpan span("slide decode");
+        try {
+            // The loader scales as it decodes, so the full-size image is never kept
+            if (job.output_width > 0 && job.output_height > 0)
+                pixbuf = Gdk::Pixbuf::create_from_file(job.path, job.output_width, job.output_height, false);
+            else if (job.max_width > 0 && job.max_height > 0)
+                pixbuf = Gdk::Pixbuf::create_from_file(job.path, job.max_width, job.max_height, true);
+            else
+                pixbuf = Gdk::Pixbuf::create_from_file(job.path);
+        } catch (const Glib::Error& e) {
+            std::cerr << "Error decoding slide " << job.path << ": " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job.generation != generation)
+                continue;
+            done.push_back({job.generation, job.index, pixbuf});
+        }
+        dispatcher.emit();
+    }
+}
+
+void SlideDecoder::on_dispatch()
+{
+    std::deque<Done> ready;
+    unsigned current_generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(done);
+        current_generation = generation;
+    }
+
+    auto ring = ring_indices();
+    bool stale = false;
+    for (auto& item : ready) {
+        if (item.generation != current_generation)
+            continue;
+        pending.erase(item.index);
+
+        // Decoded after the ring moved on, or failed to decode
+        if (!item.pixbuf || std::find(ring.begin(), ring.end(), item.index) == ring.end())
+            continue;
+
+        // Decoded for an output size that has changed since; better than
+        // nothing, but decoded again
+        bool current_size = at_output_size(item.pixbuf);
+        stale = stale || !current_size;
+
+        auto it = decoded.find(item.index);
+        if (it != decoded.end() && (!current_size || at_output_size(it->second)))
+            continue;
+        if (it != decoded.end())
+            memory_used -= pixbuf_bytes(it->second);
+        decoded[item.index] = item.pixbuf;
+        memory_used += pixbuf_bytes(item.pixbuf);
+
+        trim_to_cap();
+        if (decoded.count(item.index))
+            ready_signal.emit(item.index);
+    }
+    if (stale)
+        set_position(position);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <gdkmm/pixbuf.h>
+#include <glibmm/dispatcher.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decodes slideshow images on worker threads and keeps a ring of decoded
+// slides around the current position: the current slide first, then the next
+// and previous `lookahead` slides. Slides outside the ring are dropped, and
+// the ring is trimmed from its far ends whenever it exceeds the memory cap.
+//
+// Once the output size is known, slides are decoded straight to it, so the
+// main thread only ever swaps in a finished image. Only that scaled image is
+// kept, and it is what the memory cap counts.
+//
+// All public methods and signal_ready() belong to the GTK main thread.
+class SlideDecoder
+{
+public:
+    SlideDecoder(unsigned threads = 2, int lookahead = 2, size_t memory_cap = 512 * 1024 * 1024);
+    ~SlideDecoder();
+
+    void set_files(const std::vector<std::string>& files);
+    void set_position(int index);
+    // Bound decoded slides to this size (aspect preserved); 0 keeps full resolution
+    void set_max_size(int width, int height);
+    // Decode slides to exactly this size, the program output's; 0 until it is
+    // known. Changing it re-decodes the ring, keeping the old slides until
+    // their replacements arrive (signal_ready() fires again for each).
+    void set_output_size(int width, int height);
+
+    // Already-decoded slide, or an empty RefPtr while it is still in flight
+    Glib::RefPtr<Gdk::Pixbuf> get(int index) const;
+
+    sigc::signal<void, int>& signal_ready() { return ready_signal; }
+
+private:
+    struct Job {
+        unsigned generation;
+        int index;
+        std::string path;
+        int max_width;
+        int max_height;
+        int output_width;
+        int output_height;
+    };
+    struct Done {
+        unsigned generation;
+        int index;
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    };
+
+    bool at_output_size(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) const;
+
+    void worker_main();
+    void on_dispatch();
+    std::vector<int> ring_indices() const;
+    void trim_to_cap();
+    int ring_distance(int index) const;
+
+    // main thread state
+    std::vector<std::string> files;
+    int position = 0;
+    int lookahead;
+    size_t memory_cap;
+    size_t memory_used = 0;
+    int max_width = 0;
+    int max_height = 0;
+    int output_width = 0;
+    int output_height = 0;
+    std::map<int, Glib::RefPtr<Gdk::Pixbuf>> decoded;
+    std::set<int> pending;
+    sigc::signal<void, int> ready_signal;
+
+    // shared with the workers
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job> jobs;
+    std::deque<Done> done;
+    unsigned generation = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    Glib::Dispatcher dispatcher;
+};
@@ -0,0 +1,259 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Per thread; a GO with a cold pipeline records a few dozen events
+constexpr size_t ring_capacity = 4096;
+// Streaming threads come and go with their pipelines; keep only the latest
+constexpr size_t max_exited_rings = 32;
+
+struct Event {
+    const char* name;
+    char phase; // Chrome trace phase: X, i, b, e
+    gint64 ts_us;
+    gint64 dur_us;
+    uint64_t id;
+};
+
+struct Ring {
+    std::mutex mutex; // uncontended except while dumping
+    std::vector<Event> events;
+    size_t next = 0; // oldest event once the ring is full
+    std::string thread_name;
+    long tid = 0;
+    bool exited = false;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::deque<std::shared_ptr<Ring>> rings; // oldest first
+};
+
+// Never destroyed: threads may still exit after main() returns
+Registry& registry()
+{
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+bool initial_enabled()
+{
+    const char* value = g_getenv("STAGESHOW_TRACE");
+    return !value || std::strcmp(value, "0") != 0;
+}
+
+std::atomic<bool>& enabled_flag()
+{
+    static std::atomic<bool> flag{initial_enabled()};
+    return flag;
+}
+
+struct ThreadRing {
+    std::shared_ptr<Ring> ring;
+
+    ThreadRing()
+    {
+        ring = std::make_shared<Ring>();
+        ring->events.reserve(64);
+        ring->tid = syscall(SYS_gettid);
+        char name[16] = {};
+        if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0 && name[0])
+            ring->thread_name = name;
+        else
+            ring->thread_name = "thread " + std::to_string(ring->tid);
+
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().rings.push_back(ring);
+    }
+
+    ~ThreadRing()
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        ring->exited = true;
+        size_t exited = std::count_if(reg.rings.begin(), reg.rings.end(),
+                                      [](const std::shared_ptr<Ring>& r) { return r->exited; });
+        for (auto it = reg.rings.begin(); it != reg.rings.end() && exited > max_exited_rings;) {
+            if ((*it)->exited) {
+                it = reg.rings.erase(it);
+                exited--;
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+Ring& local_ring()
+{
+    thread_local ThreadRing holder;
+    return *holder.ring;
+}
+
+void record(const char* name, char phase, gint64 ts_us, gint64 dur_us, uint64_t id)
+{
+    if (!trace_enabled())
+        return;
+
+    Ring& ring = local_ring();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    Event event{name, phase, ts_us, dur_us, id};
+    if (ring.events.size() < ring_capacity) {
+        ring.events.push_back(event);
+    } else {
+        ring.events[ring.next] = event;
+        ring.next = (ring.next + 1) % ring_capacity;
+    }
+}
+
+gint64 or_now(gint64 us)
+{
+    return us != 0 ? us : g_get_monotonic_time();
+}
+
+void write_string(std::ostringstream& out, const std::string& value)
+{
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+}
+
+void trace_set_enabled(bool enabled)
+{
+    enabled_flag().store(enabled, std::memory_order_relaxed);
+}
+
+bool trace_enabled()
+{
+    return enabled_flag().load(std::memory_order_relaxed);
+}
+
+void trace_set_thread_name(const char* name)
+{
+    Ring& ring = local_ring();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.thread_name = name;
+}
+
+void trace_complete(const char* name, uint64_t id, gint64 start_us, gint64 end_us)
+{
+    end_us = or_now(end_us);
+    record(name, 'X', start_us, std::max<gint64>(end_us - start_us, 0), id);
+}
+
+void trace_instant(const char* name, uint64_t id, gint64 at_us)
+{
+    record(name, 'i', or_now(at_us), 0, id);
+}
+
+void trace_async_begin(const char* name, uint64_t id, gint64 at_us)
+{
+    record(name, 'b', or_now(at_us), 0, id);
+}
+
+void trace_async_end(const char* name, uint64_t id, gint64 at_us)
+{
+    record(name, 'e', or_now(at_us), 0, id);
+}
+
+std::string trace_default_path()
+{
+    const char* path = g_getenv("STAGESHOW_TRACE");
+    if (path && *path && std::strcmp(path, "0") != 0 && std::strcmp(path, "1") != 0)
+        return path;
+
+    gchar* fallback = g_build_filename(g_get_user_runtime_dir(), "linux-stageshow-trace.json", nullptr);
+    std::string result = fallback;
+    g_free(fallback);
+    return result;
+}
+
+bool trace_dump(const std::string& path, std::string& error)
+{
+    struct Thread {
+        long tid;
+        std::string name;
+        std::vector<Event> events;
+    };
+
+    // Copy out first so no ring is locked while formatting
+    std::vector<Thread> threads;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const auto& ring : reg.rings) {
+            std::lock_guard<std::mutex> ring_lock(ring->mutex);
+            if (ring->events.empty())
+                continue;
+            Thread thread{ring->tid, ring->thread_name, {}};
+            thread.events.reserve(ring->events.size());
+            thread.events.insert(thread.events.end(), ring->events.begin() + ring->next, ring->events.end());
+            thread.events.insert(thread.events.end(), ring->events.begin(), ring->events.begin() + ring->next);
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    std::ostringstream out;
+    long pid = getpid();
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const auto& thread : threads) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << thread.tid
+            << ",\"args\":{\"name\":";
+        write_string(out, thread.name);
+        out << "}}";
+
+        for (const auto& event : thread.events) {
+            separator();
+            out << "{\"name\":";
+            write_string(out, event.name);
+            out << ",\"cat\":\"cue\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.ts_us
+                << ",\"pid\":" << pid << ",\"tid\":" << thread.tid;
+            if (event.phase == 'X')
+                out << ",\"dur\":" << event.dur_us;
+            else if (event.phase == 'i')
+                out << ",\"s\":\"t\"";
+            else
+                out << ",\"id\":" << event.id;
+            if (event.id != 0)
+                out << ",\"args\":{\"cue\":" << event.id << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    GError* err = nullptr;
+    std::string json = out.str();
+    if (!g_file_set_contents(path.c_str(), json.data(), static_cast<gssize>(json.size()), &err)) {
+        error = err ? err->message : "cannot write " + path;
+        g_clear_error(&err);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glib.h>
+#include <cstdint>
+#include <string>
+
+// Spans and instants along a cue's life (GO, pipeline build, state changes,
+// preroll, first buffer, EOS, slide decode and scale), kept in a ring buffer
+// per thread so recording never contends across threads and memory stays
+// bounded. trace_dump() writes everything still in the rings as Chrome trace
+// JSON, for chrome://tracing or ui.perfetto.dev.
+//
+// Recording is on from the start, so a late cue can be looked at after the
+// fact. Names and categories must be string literals (only the pointer is
+// stored); `id` is the cue id, 0 when there is none. Times are
+// g_get_monotonic_time() microseconds; 0 means now.
+//
+// STAGESHOW_TRACE, if set, is the default dump path, and "0" turns
+// recording off.
+
+void trace_set_enabled(bool enabled);
+bool trace_enabled();
+// Shown as the thread's name in the trace; defaults to the OS thread name
+void trace_set_thread_name(const char* name);
+
+void trace_complete(const char* name, uint64_t id, gint64 start_us, gint64 end_us = 0);
+void trace_instant(const char* name, uint64_t id, gint64 at_us = 0);
+// A span that starts and ends in different calls or threads, matched by name and id
+void trace_async_begin(const char* name, uint64_t id, gint64 at_us = 0);
+void trace_async_end(const char* name, uint64_t id, gint64 at_us = 0);
+
+std::string trace_default_path();
+bool trace_dump(const std::string& path, std::string& error);
+
+// Records [construction, destruction) on the current thread
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name, uint64_t id = 0)
+    : name(name), id(id), start_us(trace_enabled() ? g_get_monotonic_time() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (start_us != 0)
+            trace_complete(name, id, start_us);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    uint64_t id;
+    gint64 start_us;
+};
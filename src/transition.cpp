@@ -0,0 +1,291 @@
+#include "transition.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+const char* transition_type_name(TransitionType type)
+{
+    switch (type) {
+        case TransitionType::Cut: return "Cut";
+        case TransitionType::Crossfade: return "Crossfade";
+        case TransitionType::DipToBlack: return "Dip to black";
+        case TransitionType::Wipe: return "Wipe";
+    }
+    return "Cut";
+}
+
+namespace {
+
+// Scalar tails, also the whole kernel on targets without SSE2
+void blend_scalar(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes, unsigned alpha)
+{
+    unsigned inv = 256 - alpha;
+    for (size_t i = 0; i < bytes; ++i)
+        dst[i] = static_cast<uint8_t>((a[i] * inv + b[i] * alpha + 128) >> 8);
+}
+
+void fade_scalar(uint8_t* dst, const uint8_t* src, size_t bytes, unsigned alpha)
+{
+    for (size_t i = 0; i < bytes; ++i)
+        dst[i] = (i & 3) == 3 ? 0xff : static_cast<uint8_t>((src[i] * alpha + 128) >> 8);
+}
+
+#if defined(__SSE2__)
+// a * (256 - t) + b * t stays below 65536, so 16-bit lanes are exact
+size_t blend_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes, unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wb = _mm_set1_epi16(static_cast<short>(alpha));
+    const __m128i wa = _mm_set1_epi16(static_cast<short>(256 - alpha));
+    const __m128i round = _mm_set1_epi16(128);
+
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+size_t fade_sse2(uint8_t* dst, const uint8_t* src, size_t bytes, unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16(static_cast<short>(alpha));
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), w), round), 8);
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), w), round), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+    return i;
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define STAGESHOW_HAVE_AVX2 1
+
+__attribute__((target("avx2")))
+size_t blend_avx2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes, unsigned alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wb = _mm256_set1_epi16(static_cast<short>(alpha));
+    const __m256i wa = _mm256_set1_epi16(static_cast<short>(256 - alpha));
+    const __m256i round = _mm256_set1_epi16(128);
+
+    // unpack/pack work per 128-bit lane, so the byte order round-trips
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+                                      _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+                                      _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), 8);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t fade_avx2(uint8_t* dst, const uint8_t* src, size_t bytes, unsigned alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i w = _mm256_set1_epi16(static_cast<short>(alpha));
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), w), round), 8);
+        __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), w), round), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
+    }
+    return i;
+}
+
+bool cpu_has_avx2()
+{
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+}
+
+void blend_rgba(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes, unsigned alpha)
+{
+    alpha = std::min(alpha, 256u);
+    size_t done = 0;
+#if defined(STAGESHOW_HAVE_AVX2)
+    if (cpu_has_avx2())
+        done = blend_avx2(dst, a, b, bytes, alpha);
+#endif
+#if defined(__SSE2__)
+    done += blend_sse2(dst + done, a + done, b + done, bytes - done, alpha);
+#endif
+    blend_scalar(dst + done, a + done, b + done, bytes - done, alpha);
+}
+
+void fade_rgba(uint8_t* dst, const uint8_t* src, size_t bytes, unsigned alpha)
+{
+    // The vector loops consume whole 16/32-byte blocks, so `done` stays a
+    // multiple of 4 and the scalar tail still finds alpha at (i & 3) == 3
+    alpha = std::min(alpha, 256u);
+    size_t done = 0;
+#if defined(STAGESHOW_HAVE_AVX2)
+    if (cpu_has_avx2())
+        done = fade_avx2(dst, src, bytes, alpha);
+#endif
+#if defined(__SSE2__)
+    done += fade_sse2(dst + done, src + done, bytes - done, alpha);
+#endif
+    fade_scalar(dst + done, src + done, bytes - done, alpha);
+}
+
+TransitionRenderer::TransitionRenderer(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(&TransitionRenderer::worker_main, this, i);
+}
+
+TransitionRenderer::~TransitionRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_cond.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void TransitionRenderer::worker_main(unsigned slot)
+{
+    unsigned seen = 0;
+    for (;;) {
+        const std::function<void(int, int)>* fn;
+        int rows;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_cond.wait(lock, [&]() { return stopping || job_generation != seen; });
+            if (stopping)
+                return;
+            seen = job_generation;
+            fn = job;
+            rows = job_rows;
+        }
+
+        unsigned shares = get_threads();
+        int begin = static_cast<int>(static_cast<long>(rows) * slot / shares);
+        int end = static_cast<int>(static_cast<long>(rows) * (slot + 1) / shares);
+        if (begin < end)
+            (*fn)(begin, end);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0)
+                done_cond.notify_one();
+        }
+    }
+}
+
+void TransitionRenderer::parallel_rows(int rows, const std::function<void(int, int)>& fn)
+{
+    if (workers.empty()) {
+        fn(0, rows);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        job_rows = rows;
+        remaining = static_cast<unsigned>(workers.size());
+        job_generation++;
+    }
+    work_cond.notify_all();
+
+    // Slot 0 belongs to the caller
+    int end = static_cast<int>(static_cast<long>(rows) / get_threads());
+    if (end > 0)
+        fn(0, end);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [this]() { return remaining == 0; });
+    job = nullptr;
+}
+
+void TransitionRenderer::render(TransitionType type, double progress,
+                                const RgbaFrame& from, const RgbaFrame& to, const RgbaFrame& out)
+{
+    progress = std::min(1.0, std::max(0.0, progress));
+    const size_t row_bytes = static_cast<size_t>(out.width) * 4;
+
+    switch (type) {
+    case TransitionType::Cut: {
+        const RgbaFrame& src = progress < 1.0 ? from : to;
+        parallel_rows(out.height, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+                std::memcpy(out.data + y * out.stride, src.data + y * src.stride, row_bytes);
+        });
+        break;
+    }
+    case TransitionType::Crossfade: {
+        unsigned alpha = static_cast<unsigned>(progress * 256.0 + 0.5);
+        parallel_rows(out.height, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+                blend_rgba(out.data + y * out.stride, from.data + y * from.stride,
+                           to.data + y * to.stride, row_bytes, alpha);
+        });
+        break;
+    }
+    case TransitionType::DipToBlack: {
+        // Out to black over the first half, in from black over the second
+        const RgbaFrame& src = progress < 0.5 ? from : to;
+        double level = progress < 0.5 ? 1.0 - progress * 2.0 : progress * 2.0 - 1.0;
+        unsigned alpha = static_cast<unsigned>(level * 256.0 + 0.5);
+        parallel_rows(out.height, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+                fade_rgba(out.data + y * out.stride, src.data + y * src.stride, row_bytes, alpha);
+        });
+        break;
+    }
+    case TransitionType::Wipe: {
+        // Left-to-right: `to` is revealed behind a moving vertical edge
+        size_t edge = static_cast<size_t>(progress * out.width + 0.5) * 4;
+        parallel_rows(out.height, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                uint8_t* dst = out.data + y * out.stride;
+                std::memcpy(dst, to.data + y * to.stride, edge);
+                std::memcpy(dst + edge, from.data + y * from.stride + edge, row_bytes - edge);
+            }
+        });
+        break;
+    }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Slide-to-slide transitions rendered on the CPU. Everything here works on
+// plain RGBA byte buffers (no GTK), so the kernels can be benchmarked on
+// their own; see bench/transition_bench.cpp.
+
+enum class TransitionType {
+    Cut,
+    Crossfade,
+    DipToBlack,
+    Wipe
+};
+
+const char* transition_type_name(TransitionType type);
+
+// Non-owning view of a tightly or loosely packed 8-bit RGBA image
+struct RgbaFrame {
+    uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+};
+
+// Vectorized per-byte kernels; alpha is 0..256 (256 = fully `b` / fully `src`)
+void blend_rgba(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t bytes, unsigned alpha);
+// Scales colour towards black and forces the alpha byte to opaque
+void fade_rgba(uint8_t* dst, const uint8_t* src, size_t bytes, unsigned alpha);
+
+// Renders transition frames, splitting rows across a fixed pool of threads.
+// The calling thread takes one share of the rows itself.
+class TransitionRenderer
+{
+public:
+    explicit TransitionRenderer(unsigned threads = 0); // 0: one per core
+    ~TransitionRenderer();
+
+    TransitionRenderer(const TransitionRenderer&) = delete;
+    TransitionRenderer& operator=(const TransitionRenderer&) = delete;
+
+    // `from`, `to` and `out` must share width and height; progress is 0..1
+    void render(TransitionType type, double progress,
+                const RgbaFrame& from, const RgbaFrame& to, const RgbaFrame& out);
+
+    unsigned get_threads() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    void parallel_rows(int rows, const std::function<void(int, int)>& fn);
+    void worker_main(unsigned slot);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cond;
+    std::condition_variable done_cond;
+    const std::function<void(int, int)>* job = nullptr;
+    int job_rows = 0;
+    unsigned job_generation = 0;
+    unsigned remaining = 0;
+    bool stopping = false;
+};
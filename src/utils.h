@@ -1,8 +1,9 @@
 #pragma once
 #include <iomanip>
 #include <sstream>
+#include <string>
 
-std::string format_seconds_to_hhmmss(int total_seconds) {
+inline std::string format_seconds_to_hhmmss(int total_seconds) {
     int hours = total_seconds / 3600;
     int minutes = (total_seconds % 3600) / 60;
     int seconds = total_seconds % 60;